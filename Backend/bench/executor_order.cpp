@@ -0,0 +1,102 @@
+// checks that the db executor runs the requests queued behind a busy thread in the order they
+// arrived. the executor's only thread is held up by a first piece of work while the others are
+// submitted from outside of it, like the I/O threads submit queries, and then let go.
+//
+//   g++ -O2 -Iinclude -I../Contrib/pion-net-3.0.15/common/include -o executor_order
+//     bench/executor_order.cpp lib/DBExecutor.cpp -lpion-common -lboost_thread -lboost_system
+//   ./executor_order [requests]
+//
+// prints the order the requests ran in if it isn't the order they were submitted in, and exits
+// with status 1 then.
+
+#include "DBExecutor.h"
+#include <boost/bind.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+  class Gate {
+  public:
+    Gate() : _open(false) {}
+    void open() {
+      boost::mutex::scoped_lock lock(_mutex);
+      _open = true;
+      _changed.notify_all();
+    }
+    void wait() {
+      boost::mutex::scoped_lock lock(_mutex);
+      while (!_open)
+        _changed.wait(lock);
+    }
+  private:
+    boost::mutex _mutex;
+    boost::condition _changed;
+    bool _open;
+  };
+
+  class Log {
+  public:
+    explicit Log(const size_t expected) : _expected(expected) {}
+    void ran(const size_t request) {
+      boost::mutex::scoped_lock lock(_mutex);
+      _order.push_back(request);
+      if (_order.size() == _expected)
+        _done.notify_all();
+    }
+    std::vector<size_t> wait() {
+      boost::mutex::scoped_lock lock(_mutex);
+      while (_order.size() < _expected)
+        _done.wait(lock);
+      return _order;
+    }
+  private:
+    boost::mutex _mutex;
+    boost::condition _done;
+    const size_t _expected;
+    std::vector<size_t> _order;
+  };
+
+  void busy(Gate& started, Gate& release) {
+    started.open();
+    release.wait();
+  }
+}
+
+int main(int argc, char** argv) {
+  const size_t requests(argc > 1 ? atoi(argv[1]) : 64);
+  if (!requests) {
+    fprintf(stderr, "usage: %s [requests]\n", argv[0]);
+    return 1;
+  }
+  Log log(requests);
+  std::vector<size_t> order;
+  {
+    DBExecutor executor(1,requests+1);
+    Gate started, release;
+    executor.submit(boost::bind(&busy,boost::ref(started),boost::ref(release)));
+    started.wait();
+    for (size_t i(0); i<requests; ++i) {
+      if (!executor.trySubmit(boost::bind(&Log::ran,&log,i))) {
+        fprintf(stderr, "request %lu was turned away\n", static_cast<unsigned long>(i));
+        return 1;
+      }
+    }
+    release.open();
+    order = log.wait();
+  }
+  bool inOrder(true);
+  for (size_t i(0); i<requests; ++i)
+    inOrder = inOrder && order[i] == i;
+  if (inOrder) {
+    printf("%lu requests ran in the order they arrived\n", static_cast<unsigned long>(requests));
+    return 0;
+  }
+  printf("requests ran out of order:");
+  for (size_t i(0); i<requests; ++i)
+    printf(" %lu", static_cast<unsigned long>(order[i]));
+  printf("\n");
+  return 1;
+}
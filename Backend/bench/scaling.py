@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+# measures how request throughput on the read endpoints scales with the number of server threads.
+# the backend is started once per scheduler and thread count, in a scratch directory so every
+# run gets the same fresh cache db, and a pool of client processes requests the endpoints over
+# keep-alive connections for a while. the clients run on the same machine as the server, so
+# leave them some cores: by default the thread count only goes up to half of them.
+#
+#   bench/scaling.py --server src/brainslug_backend
+#
+# prints requests per second for every run, and the speedup over a single thread.
+
+import argparse
+import http.client
+import multiprocessing
+import os
+import shutil
+import socket
+import subprocess
+import tempfile
+import time
+
+ENDPOINTS = [
+    "/movies?list",
+    "/tvshows?list",
+    "/seasons?list&expand=episodes",
+    "/episodes?list&limit=50",
+    "/episodes?view&id=1",
+]
+
+
+def client(port, endpoints, duration, results):
+    conn = http.client.HTTPConnection("127.0.0.1", port)
+    done = 0
+    failed = 0
+    deadline = time.time() + duration
+    while time.time() < deadline:
+        for endpoint in endpoints:
+            try:
+                conn.request("GET", endpoint)
+                response = conn.getresponse()
+                response.read()
+                if response.status == 200:
+                    done += 1
+                else:
+                    failed += 1
+            except (http.client.HTTPException, OSError):
+                failed += 1
+                conn.close()
+                conn = http.client.HTTPConnection("127.0.0.1", port)
+    conn.close()
+    results.put((done, failed))
+
+
+def wait_for_port(port, server, timeout=30):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        if server.poll() is not None:
+            raise RuntimeError("the server exited with status %d" % server.returncode)
+        try:
+            socket.create_connection(("127.0.0.1", port), 0.2).close()
+            return
+        except OSError:
+            time.sleep(0.1)
+    raise RuntimeError("the server didn't start listening on port %d" % port)
+
+
+def run(args, scheduler, threads):
+    scratch = tempfile.mkdtemp(prefix="brainslug-bench-")
+    command = [os.path.abspath(args.server), "-p", str(args.port),
+               "--scheduler", scheduler, "--threads", str(threads)] + args.server_args
+    server = subprocess.Popen(command, cwd=scratch, stdout=subprocess.DEVNULL)
+    try:
+        wait_for_port(args.port, server)
+        results = multiprocessing.Queue()
+        clients = [multiprocessing.Process(target=client, args=(args.port, args.endpoints, args.duration, results))
+                   for _ in range(args.connections)]
+        for c in clients:
+            c.start()
+        totals = [results.get() for _ in clients]
+        for c in clients:
+            c.join()
+        done = sum(t[0] for t in totals)
+        failed = sum(t[1] for t in totals)
+        return done / float(args.duration), failed
+    finally:
+        server.terminate()
+        server.wait()
+        shutil.rmtree(scratch, ignore_errors=True)
+
+
+def main():
+    cores = multiprocessing.cpu_count()
+    parser = argparse.ArgumentParser(description="measures throughput of the read endpoints by server thread count")
+    parser.add_argument("--server", required=True, help="the brainslug_backend binary")
+    parser.add_argument("--port", type=int, default=5599)
+    parser.add_argument("--max-threads", type=int, default=max(1, cores // 2))
+    parser.add_argument("--schedulers", nargs="+", default=["shared", "one-to-one", "sharded"])
+    parser.add_argument("--connections", type=int, default=0, help="client connections, by default twice the max threads")
+    parser.add_argument("--duration", type=float, default=10, help="seconds every run lasts")
+    parser.add_argument("--endpoints", nargs="+", default=ENDPOINTS)
+    parser.add_argument("server_args", nargs=argparse.REMAINDER, help="passed on to the server after --")
+    args = parser.parse_args()
+    if args.server_args[:1] == ["--"]:
+        args.server_args = args.server_args[1:]
+    if not args.connections:
+        args.connections = 2 * args.max_threads
+
+    counts = []
+    n = 1
+    while n < args.max_threads:
+        counts.append(n)
+        n *= 2
+    counts.append(args.max_threads)
+
+    print("%d client connections, %gs per run, %d cores" % (args.connections, args.duration, cores))
+    print("%-12s %8s %12s %8s %8s" % ("scheduler", "threads", "requests/s", "speedup", "failed"))
+    for scheduler in args.schedulers:
+        base = None
+        for threads in counts:
+            rate, failed = run(args, scheduler, threads)
+            base = base or rate
+            print("%-12s %8d %12.0f %7.2fx %8d" % (scheduler, threads, rate, rate / base if base else 0, failed))
+
+
+if __name__ == "__main__":
+    main()
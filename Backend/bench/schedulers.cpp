@@ -0,0 +1,111 @@
+// measures how long the pion schedulers take to run skewed work posted to them. most work items
+// are short, but every threads-th one is slow, so handing them out round robin puts all of the
+// slow ones on the same thread. the work is posted from outside of the scheduler and, like a
+// request fanning out into queries, by some of the work items themselves.
+//
+//   g++ -O2 -I../Contrib/pion-net-3.0.15/common/include -o schedulers bench/schedulers.cpp
+//     -lpion-common -lboost_thread -lboost_system
+//   ./schedulers [threads] [items]
+//
+// prints the time every scheduler took and the work items it ran per second.
+
+#include <pion/PionScheduler.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+  const long FAST_ITEM = 20; // microseconds
+  const long SLOW_ITEM = 2000;
+  const size_t FAN_OUT = 4; // work items posted by every 16th item
+
+  boost::posix_time::ptime now() {
+    return boost::posix_time::microsec_clock::universal_time();
+  }
+
+  // keeps the thread busy rather than sleeping, like a query would
+  void spin(const long microseconds) {
+    const boost::posix_time::ptime until(now() + boost::posix_time::microseconds(microseconds));
+    while (now() < until)
+      ;
+  }
+
+  class Countdown {
+  public:
+    explicit Countdown(const size_t count) : _count(count) {}
+    void add(const size_t count) {
+      boost::mutex::scoped_lock lock(_mutex);
+      _count += count;
+    }
+    void done() {
+      boost::mutex::scoped_lock lock(_mutex);
+      if (--_count == 0)
+        _zero.notify_all();
+    }
+    void wait() {
+      boost::mutex::scoped_lock lock(_mutex);
+      while (_count)
+        _zero.wait(lock);
+    }
+  private:
+    boost::mutex _mutex;
+    boost::condition _zero;
+    size_t _count;
+  };
+
+  void spinItem(Countdown& countdown) {
+    spin(FAST_ITEM);
+    countdown.done();
+  }
+
+  void item(pion::PionScheduler& scheduler, Countdown& countdown, const size_t i, const size_t threads) {
+    if (i % 16 == 1) {
+      countdown.add(FAN_OUT);
+      for (size_t j(0); j<FAN_OUT; ++j)
+        scheduler.post(boost::bind(&spinItem, boost::ref(countdown)));
+    }
+    spin(i % threads == 0 ? SLOW_ITEM : FAST_ITEM);
+    countdown.done();
+  }
+
+  void run(const std::string& name, pion::PionScheduler& scheduler, const size_t threads, const size_t items) {
+    scheduler.setNumThreads(threads);
+    scheduler.addActiveUser();
+    Countdown countdown(items);
+    const boost::posix_time::ptime start(now());
+    for (size_t i(0); i<items; ++i)
+      scheduler.post(boost::bind(&item, boost::ref(scheduler), boost::ref(countdown), i, threads));
+    countdown.wait();
+    const double seconds((now() - start).total_microseconds() / 1e6);
+    scheduler.removeActiveUser();
+    scheduler.shutdown();
+    printf("%-14s %10.0f %12.0f\n", name.c_str(), seconds*1000, items/seconds);
+  }
+}
+
+int main(int argc, char** argv) {
+  const size_t threads(argc > 1 ? atoi(argv[1]) : boost::thread::hardware_concurrency());
+  const size_t items(argc > 2 ? atoi(argv[2]) : 20000);
+  if (!threads || !items) {
+    fprintf(stderr, "usage: %s [threads] [items]\n", argv[0]);
+    return 1;
+  }
+  printf("%lu threads, %lu work items\n", static_cast<unsigned long>(threads), static_cast<unsigned long>(items));
+  printf("%-14s %10s %12s\n", "scheduler", "ms", "items/s");
+  {
+    pion::PionSingleServiceScheduler scheduler;
+    run("shared", scheduler, threads, items);
+  }
+  {
+    pion::PionOneToOneScheduler scheduler;
+    run("one-to-one", scheduler, threads, items);
+  }
+  {
+    pion::PionWorkStealingScheduler scheduler;
+    run("work-stealing", scheduler, threads, items);
+  }
+  return 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "Conf.h"
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <vector>
+
+// hands out fixed size output buffers and takes them back once the last reference to
+// them is gone, so serializing a response doesn't have to go to the allocator every time.
+// buffers may outlive the pool that created them.
+
+class BufferPool : private boost::noncopyable {
+public:
+  struct Buffer {
+    Buffer(const size_t capacity) : _data(capacity), _size(0) {}
+    char* data() { return &_data[0]; }
+    size_t size() const { return _size; }
+    size_t capacity() const { return _data.size(); }
+    size_t available() const { return _data.size() - _size; }
+    std::vector<char> _data;
+    size_t _size;
+  };
+  typedef boost::shared_ptr<Buffer> BufferPtr;
+
+  BufferPool(const size_t bufferSize = RESPONSE_BUFFER_SIZE, const size_t maxIdle = RESPONSE_BUFFER_POOL_SIZE);
+  BufferPtr acquire();
+  size_t bufferSize() const;
+
+private:
+  struct Freelist {
+    Freelist(const size_t maxIdle) : _maxIdle(maxIdle) {}
+    ~Freelist();
+    boost::mutex _mutex;
+    std::vector<Buffer*> _idle;
+    const size_t _maxIdle;
+  };
+  struct Recycler {
+    Recycler(const boost::shared_ptr<Freelist>& freelist) : _freelist(freelist) {}
+    void operator()(Buffer* buffer) const;
+    boost::shared_ptr<Freelist> _freelist;
+  };
+
+  const size_t _bufferSize;
+  const boost::shared_ptr<Freelist> _freelist;
+};
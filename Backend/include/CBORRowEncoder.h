@@ -0,0 +1,33 @@
+#pragma once
+#include "RowEncoder.h"
+#include <vector>
+
+// encodes query results as CBOR (RFC 7049), in the same layout as the json documents. the
+// document, the content array and rows with nested arrays are of indefinite length since they
+// are streamed, all other rows are maps of their columns. integers take as few bytes as their
+// value needs and floats are single precision whenever that doesn't lose anything. unlike json,
+// CBOR can carry nan and infinity, so those are sent as they are instead of as null
+
+class CBORRowEncoder : public RowEncoder {
+public:
+  CBORRowEncoder(BufferPool& pool);
+  virtual void begin();
+  virtual void row(const ResultRow& row);
+  virtual void openRow(const ResultRow& row);
+  virtual void openArray(const std::string& name);
+  virtual void closeArray();
+  virtual void closeRow();
+  virtual void end(const std::string* error = 0);
+  virtual void end(const std::string* error, const std::string* next);
+
+private:
+  void appendColumns(const ResultRow& row);
+  void appendHead(const unsigned char majorType, const boost::uint64_t value);
+  void appendString(const char* data, const size_t size);
+  void appendNullableString(const std::string* value);
+  void appendInteger(const boost::int64_t value);
+  void appendFloat(const double value);
+
+  size_t _depth; // of the array rows currently go into
+  std::vector<std::vector<std::string> > _keys; // the encoded name of every column of each depth, built from the first row
+};
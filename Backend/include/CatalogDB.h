@@ -0,0 +1,55 @@
+#pragma once
+#include "SQLitePoolDB.h"
+#include "CatalogTable.h"
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <set>
+
+// a sqlite pool db that keeps the tables behind registered views in memory and answers plain
+// selects of those views from there, without touching sqlite. everything else, like paged or
+// joined queries, is still run by sqlite. the copies are kept coherent by the writer: sqlite
+// reports every row the writer connection changes, and after each write batch those rows are
+// read back and swapped into new copies of their tables before the batch's writes complete
+
+class CatalogDB : public SQLitePoolDB {
+public:
+  struct Stats {
+    Stats() : tables(0), rows(0), hits(0), misses(0), refreshes(0) {}
+    size_t tables;
+    size_t rows;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long refreshes;
+  };
+
+  CatalogDB(const size_t writeBatchSize = WRITE_BATCH_SIZE, const size_t writeBatchLatency = WRITE_BATCH_LATENCY);
+  virtual ~CatalogDB();
+  virtual CursorPtr openCursor(const std::string& query, std::string& errorMessage, const SanitizedParams& sp = SanitizedParams(), const PageParams& page = PageParams()) const;
+  // loads the table behind a view into memory. the view has to be of the form
+  // "select column [as alias], ... from table", indexed columns get hash indexes
+  bool cacheView(const std::string& viewStatement, const std::vector<std::string>& indexedColumns, std::string& errorMessage);
+  Stats catalogStats() const;
+
+protected:
+  virtual void rowWritten(const std::string& table, const boost::int64_t rowid);
+  virtual void tableChanged(const std::string& table);
+  virtual void batchWritten();
+
+private:
+  struct Table {
+    std::string selectStatement; // the rowid followed by the cached columns
+    std::vector<CatalogTable::Column> columns;
+    CatalogTable::Ptr rows;
+  };
+  typedef std::map<std::string,Table> Tables;
+
+  CatalogTable::Ptr cachedRows(const std::string& query) const;
+  void refresh();
+
+  mutable boost::mutex _mutex;
+  Tables _tables;
+  std::map<std::string,std::string> _views; // view and list statements to their table
+  std::map<std::string,std::set<boost::int64_t> > _changed; // rows written since the last refresh
+  std::set<std::string> _reload; // tables that changed wholesale
+  mutable Stats _stats;
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include "DB.h"
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <set>
+#include <vector>
+
+// an immutable in-memory copy of the rows of a table, stored column by column. integers sit in
+// one array per column and text in one character arena per column, so answering a query walks
+// a few contiguous arrays. integer columns marked as indexed get a hash index from value to rows.
+// rows are kept in rowid order, the order sqlite returns a plain select in. changes produce a
+// new table, so cursors can keep reading the copy they were opened on without any locking
+
+class CatalogTable : public boost::enable_shared_from_this<CatalogTable> {
+public:
+  struct Column {
+    Column(const std::string& n, const std::string& a, const bool i) : name(n), alias(a), indexed(i) {}
+    std::string name; // in the sql table
+    std::string alias; // in results
+    bool indexed;
+  };
+  typedef boost::shared_ptr<const CatalogTable> Ptr;
+
+  CatalogTable(const std::vector<Column>& columns);
+  // the table built from the rows of a select returning the rowid followed by the columns
+  static Ptr load(const std::vector<Column>& columns, Cursor& rows);
+  // a copy in which the changed rowids hold the rows of the select instead, ordered by rowid.
+  // changed rowids the select doesn't return have been deleted
+  Ptr update(Cursor& rows, const std::set<boost::int64_t>& changed) const;
+  // a cursor on the rows matching all params, or null if the params don't name columns of the table
+  CursorPtr select(const SanitizedParams& sp) const;
+
+  size_t size() const;
+  const std::vector<Column>& columns() const;
+
+private:
+  struct ColumnData {
+    std::vector<unsigned char> types; // ResultRow::ColumnType
+    std::vector<boost::int64_t> values; // integers, the bits of floats, or the offset of text
+    std::vector<size_t> sizes; // of text
+    std::string text;
+  };
+  typedef boost::unordered_multimap<boost::int64_t,size_t> Index;
+  class Row;
+  class Selection;
+
+  void append(const ResultRow& row);
+  void append(const CatalogTable& table, const size_t slot);
+  void buildIndexes();
+  bool matches(const size_t column, const size_t slot, const SanitizedParam& value) const;
+
+  std::vector<Column> _columns;
+  std::vector<boost::int64_t> _rowids;
+  std::vector<ColumnData> _data;
+  std::vector<Index> _indexes; // empty for columns that aren't indexed
+};
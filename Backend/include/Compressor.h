@@ -0,0 +1,29 @@
+#pragma once
+#include "Conf.h"
+#include <boost/noncopyable.hpp>
+#include <string>
+#include <zlib.h>
+
+// compresses a response body for the gzip or deflate content coding, either in one go or a
+// piece at a time while it is being streamed. every flush makes all of the body given so far
+// decompressible by the client, so a streamed response doesn't stall in the compressor
+
+class Compressor : private boost::noncopyable {
+public:
+  // coding is the name of a content coding, which has to be one of these
+  static const std::string GZIP;
+  static const std::string DEFLATE;
+
+  Compressor(const std::string& coding, const int level = COMPRESSION_LEVEL);
+  ~Compressor();
+  // compresses size bytes of data, appending whatever comes out to out
+  void write(const char* data, const size_t size, std::string& out);
+  // appends what the compressor is still holding back. finishing ends the body, nothing can be
+  // written after that
+  void flush(std::string& out, const bool finish = false);
+
+private:
+  void deflate(const int flush, std::string& out);
+
+  z_stream _stream;
+};
@@ -1,10 +1,70 @@
 #pragma once
 #include <cstddef> // for size_t etc.
 #include <cassert>
+#include <cerrno>
+#include <cstdlib>
 #include <map>
 #include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
 
 #define DEFAULT_PORT 5555
+#define DEFAULT_SCHEDULER "shared"
+#define SERVER_THREADS 8 // pion's default
 #define DB_CACHE "cache.db"
+#define STATEMENT_CACHE_SIZE 64
+#define DB_BUSY_TIMEOUT 5000 // ms
+#define DB_THREADS 4 // run queries off the I/O threads
+#define DB_QUEUE_SIZE 1024 // requests waiting for a db thread before new ones are turned away
+#define WRITE_BATCH_SIZE 256
+#define WRITE_BATCH_LATENCY 5 // ms
+// the rows of a table a batch of writes changed are read back into the catalog with a single IN
+// lookup. that isn't bound by MAX_MULTI_GET_SIZE, which limits what clients may ask for, but by
+// the point where reading the whole table back is as quick as looking up that many rows
+#define CATALOG_RELOAD_SIZE 256
+#define RESPONSE_BUFFER_SIZE 16384
+#define RESPONSE_BUFFER_POOL_SIZE 256
+#define RESPONSE_CHUNK_SIZE 65536
+#define RESPONSE_CACHE_SIZE (16*1024*1024) // bytes of serialized responses
+#define COMPRESSION_LEVEL 6 // zlib's, 1 is the fastest and 9 the smallest
+#define MIN_COMPRESSED_SIZE 1024 // bytes, smaller responses aren't worth compressing
+#define MAX_PAGE_SIZE 5000
+#define MAX_MULTI_GET_SIZE 256 // values of a single view key
 
-typedef std::map<std::string,std::string> SanitizedParams;
+// a whitelisted query param value, tagged with the type of the column it is matched
+// against so that it can be bound to a query without conversions
+struct SanitizedParam {
+  enum Type { Text, Integer };
+  SanitizedParam(const std::string& v, const Type t = Text) : value(v), type(t) {}
+  // parses the value as a decimal integer, false if it is empty or anything else
+  bool integerValue(boost::int64_t& parsed) const {
+    const char* const begin(value.c_str());
+    char* end(0);
+    errno = 0;
+    parsed = strtoll(begin,&end,10);
+    return errno == 0 && end != begin && *end == '\0';
+  }
+  std::string value;
+  Type type;
+};
+
+// a key given several times matches rows holding any of its values
+typedef std::multimap<std::string,SanitizedParam> SanitizedParams;
+
+// sanitized ordering and keyset pagination for a query. rows are sorted by orderColumn with
+// ties broken by keyColumn, and if hasAfter is set they start right behind the row holding
+// afterOrder/afterKey, so every page is an index seek rather than an offset scan
+struct PageParams {
+  PageParams()
+    : descending(false), limit(0), hasAfter(false), afterOrder(std::string()), afterOrderIsNull(false), afterKey(std::string()) {}
+  bool empty() const { return keyColumn.empty(); }
+  std::vector<std::string> groupColumns; // sorted by ahead of the order column, outside of the keyset
+  std::string orderColumn;
+  std::string keyColumn;
+  bool descending;
+  size_t limit; // 0 returns every row
+  bool hasAfter;
+  SanitizedParam afterOrder;
+  bool afterOrderIsNull;
+  SanitizedParam afterKey;
+};
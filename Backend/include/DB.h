@@ -2,22 +2,75 @@
 #include "Conf.h"
 #include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
+#include <boost/cstdint.hpp>
 #include <json/elements.h>
 #include <string>
 #include <utility>
 
 typedef boost::shared_ptr<json::Object> JSONObjectPtr;
 
+// a typed, read-only view of the row a query is currently positioned on. text points
+// into the db's own buffers and is only valid until the row callback returns
+
+class ResultRow {
+public:
+  enum ColumnType { Integer, Float, Text, Null };
+  struct TextValue {
+    const char* data;
+    size_t size;
+  };
+
+  virtual ~ResultRow() {}
+  virtual int columnCount() const = 0;
+  virtual const char* columnName(const int column) const = 0;
+  virtual ColumnType columnType(const int column) const = 0;
+  virtual boost::int64_t integerValue(const int column) const = 0;
+  virtual double floatValue(const int column) const = 0;
+  virtual TextValue textValue(const int column) const = 0;
+};
+
+// a query whose rows are pulled one at a time. a cursor may be put aside between rows
+// and resumed later, even from another thread, as long as only one thread uses it at once
+
+class Cursor {
+public:
+  virtual ~Cursor() {}
+  // moves to the next row. returns false once the rows are exhausted or the query failed
+  virtual bool next() = 0;
+  // the row the cursor is positioned on, only valid after next() returned true
+  virtual const ResultRow& row() const = 0;
+  // true if next() stopped because of an error rather than because it ran out of rows
+  virtual bool failed(std::string& errorMessage) const = 0;
+};
+
+typedef boost::shared_ptr<Cursor> CursorPtr;
+
 // base class representing a database of some kind that supports
 // returning results as JSON structures
 
 class DB {
 public:
   virtual ~DB() {}
-  typedef boost::function<void (int, char**, char**)> ExecuteCallback;
+  typedef boost::function<void (const ResultRow&)> ExecuteCallback;
+  typedef boost::function<void (bool, const std::string&)> WriteCallback;
   virtual bool execute(const std::string& query, std::string& errorMessage, const ExecuteCallback& callback = ExecuteCallback(), const SanitizedParams& params = SanitizedParams()) const { 
     return false;
   }
+  // returns 0 and sets errorMessage if the query can't be run
+  virtual CursorPtr openCursor(const std::string& query, std::string& errorMessage, const SanitizedParams& params = SanitizedParams(), const PageParams& page = PageParams()) const {
+    errorMessage = "cursors are not supported by this db";
+    return CursorPtr();
+  }
+  // queues a statement that doesn't return results. implementations may batch queued
+  // writes; the callback is invoked with the outcome once the write has been committed
+  virtual void queueWrite(const std::string& statement, const WriteCallback& callback = WriteCallback()) const {
+    std::string errorMessage;
+    const bool ok(execute(statement,errorMessage));
+    if (callback)
+      callback(ok,errorMessage);
+  }
+  // blocks until every write queued so far has been committed
+  virtual void waitForQueuedWrites() const {}
   // returns a JSON document containing:
   // 1) all items in the given source (or nothing if the source is empty)
   // 2) an error or null if everything succeeded
@@ -0,0 +1,48 @@
+#pragma once
+#include "Conf.h"
+#include <pion/PionScheduler.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+// runs db work on threads of its own, so that a slow query only holds up the requests queued
+// behind it rather than every connection on the I/O thread that parsed its request. the work is
+// spread over the threads by a work-stealing scheduler, which starts work submitted from outside
+// of them in the order it arrived (bench/executor_order.cpp checks this). new requests are only
+// let in while fewer than maxQueued pieces of work wait for a thread, whatever continues a
+// response already under way always is. work still queued when the executor is destroyed is dropped
+
+class DBExecutor : private boost::noncopyable {
+public:
+  typedef boost::function<void ()> Work;
+
+  struct Stats {
+    Stats() : threads(0), capacity(0), queued(0), busy(0), executed(0), rejected(0), totalWait(0), maxWait(0) {}
+    size_t threads;
+    size_t capacity;
+    size_t queued; // waiting for a thread
+    size_t busy; // running on one
+    unsigned long executed;
+    unsigned long rejected;
+    boost::uint64_t totalWait; // us spent queued by the executed work
+    boost::uint64_t maxWait; // us spent queued by any work that has started
+  };
+
+  DBExecutor(const size_t threads = DB_THREADS, const size_t maxQueued = DB_QUEUE_SIZE);
+  ~DBExecutor();
+  // queues work unless the queue is full, returns whether it was queued
+  bool trySubmit(const Work& work);
+  // queues work however long the queue is
+  void submit(const Work& work);
+  Stats stats() const;
+
+private:
+  void run(const Work& work, const boost::posix_time::ptime& queuedAt);
+  void finished(const boost::uint64_t wait);
+
+  const size_t _maxQueued;
+  pion::PionWorkStealingScheduler _scheduler;
+  mutable boost::mutex _mutex;
+  Stats _stats;
+};
@@ -4,7 +4,10 @@
 #include "TVShowsResourceHandler.h"
 #include "SeasonsResourceHandler.h"
 #include "EpisodesResourceHandler.h"
+#include "StatusResourceHandler.h"
 #include "DB.h"
+#include <pion/PionScheduler.hpp>
+#include <boost/scoped_ptr.hpp>
 
 struct Options;
 
@@ -12,9 +15,12 @@ class FrontendServer {
 public:
   FrontendServer(const Options&);
   void run();
+  // reports every search param that isn't looked up or paged through with an index on stderr
+  bool checkQueryPlans() const;
 private:
   void handleNotFound(pion::net::HTTPRequestPtr&,pion::net::TCPConnectionPtr&);
 
+  const boost::scoped_ptr<pion::PionScheduler> _scheduler;
   pion::net::HTTPServer _httpServer;
   const DBPtr _cacheDB;
   MoviesResourceHandler _mh;
@@ -22,4 +28,5 @@ private:
   TVShowsResourceHandler _tvh;
   SeasonsResourceHandler _sh;
   EpisodesResourceHandler _eh;
+  StatusResourceHandler _sth;
 };
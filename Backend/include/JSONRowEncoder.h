@@ -0,0 +1,28 @@
+#pragma once
+#include "RowEncoder.h"
+#include <vector>
+
+// encodes query results as the {"content":[...],"next":...,"error":...} document the handlers used
+// to build as a json::Object, but without a DOM and without any whitespace
+
+class JSONRowEncoder : public RowEncoder {
+public:
+  JSONRowEncoder(BufferPool& pool);
+  virtual void begin();
+  // every level of nesting caches the keys of its own columns
+  virtual void openRow(const ResultRow& row);
+  virtual void openArray(const std::string& name);
+  virtual void closeArray();
+  virtual void closeRow();
+  virtual void end(const std::string* error = 0);
+  virtual void end(const std::string* error, const std::string* next);
+
+private:
+  void appendString(const char* data, const size_t size);
+  void appendNullableString(const std::string* value);
+  void appendInteger(const boost::int64_t value);
+  void appendFloat(const double value);
+
+  std::vector<size_t> _items; // rows encoded so far in each open array
+  std::vector<std::vector<std::string> > _keys; // "columnName": for every column of each depth, built from the first row
+};
@@ -3,5 +3,15 @@
 
 struct Options {
 	size_t port;
+	std::string scheduler; // shared, one-to-one or sharded
+	size_t threads; // 0 is one per core
+	size_t dbThreads; // 0 runs queries on the I/O threads
+	size_t dbQueueSize;
+	size_t writeBatchSize;
+	size_t writeBatchLatency; // ms
+	size_t chunkSize;
+	size_t responseCacheSize; // bytes
+	int compressionLevel;
+	bool checkQueryPlans;
 };
 
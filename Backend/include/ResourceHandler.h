@@ -1,27 +1,88 @@
 #pragma once
 #include "DB.h"
+#include "DBExecutor.h"
+#include "ResponseCache.h"
 #include <pion/net/HTTPServer.hpp>
 #include <pion/net/HTTPResponseWriter.hpp>
 #include <json/elements.h>
 
 class ResourceHandler {
 public:
+  // one level of an expanded view. its rows are nested into the member array of the row on the
+  // level above whose id is in their parentKey column, so they have to be ordered such that the
+  // children of each row come up one after the other
+  struct Expansion {
+    std::string member;
+    std::string parentKey;
+    std::string statement;
+    PageParams order;
+  };
+
   ResourceHandler(const DBPtr db, const std::string& source);
   virtual ~ResourceHandler();
   virtual void handle(pion::net::HTTPRequestPtr&,pion::net::TCPConnectionPtr&);
   virtual void initTestData();
+  // results larger than this many bytes are streamed with chunked encoding, 0 never chunks
+  void setChunkSize(const size_t chunkSize);
+  // results are compressed with zlib at this level for clients that accept gzip or deflate, 0 never compresses
+  void setCompressionLevel(const int level);
+  // successful responses sent in one piece are kept in the cache and sent from there until the
+  // tables they were read from are written to. null disables caching
+  void setResponseCache(const boost::shared_ptr<ResponseCache>& cache);
+  // queries are run and their results encoded on the executor, and the responses written back on
+  // the I/O thread of their connection. null runs them on the I/O thread right away
+  void setExecutor(const boost::shared_ptr<DBExecutor>& executor);
+  // checks that looking the resource up by any of its search params, and paging through it
+  // ordered by any of them, is done with an index. the error message names every lookup that
+  // scans a table instead
+  bool checkQueryPlans(std::string& errorMessage) const;
+  // keeps the resource's rows in memory if the db is a catalog, with hash indexes on the integer search params
+  bool cacheInCatalog(std::string& errorMessage) const;
 
 protected:
   DBPtr db() const;
   const std::string& source() const;
+  const boost::shared_ptr<ResponseCache>& responseCache() const;
+  const boost::shared_ptr<DBExecutor>& executor() const;
   virtual SanitizedParams sanitizeQueryParams(const pion::net::HTTPTypes::QueryParams& dirtyParams) const { return SanitizedParams(); }
   virtual std::string listStatement() const { return std::string(); }
   virtual std::string viewStatement() const { return std::string(); } // in derived classes this must return a select statement which allows a where clause to be appended to the end
   virtual void list(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection);
   virtual void view(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection);
-  static void writeJsonHttpResponse(const json::Object& obj, pion::net::HTTPResponseWriter& writer, const bool setStatusOK=true);
+  // fills in the levels of an expand param, starting with the resource's own rows. returns false
+  // if the resource can't be expanded like that
+  virtual bool expansion(const std::string& expand, std::vector<Expansion>& levels) const { return false; }
+  // parses the limit, order and after params of a list or view. the order key is the public name of
+  // the column the results are ordered by. returns false with an error message if they are invalid
+  bool sanitizePageParams(const pion::net::HTTPTypes::QueryParams& dirtyParams, PageParams& page, std::string& orderKey, std::string& errorMessage) const;
+  // runs the query and streams its rows to the client as a json or CBOR document, whichever the
+  // Accept header of the request prefers
+  void writeQueryResults(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection, const std::string& stmt, const SanitizedParams& sq, const PageParams& page = PageParams(), const std::string& orderKey = std::string());
+  // runs one query per level and streams their rows nested into each other
+  void writeExpandedResults(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection, const std::vector<Expansion>& levels, const SanitizedParams& sq);
+  // documents are written without any whitespace unless they're asked to be pretty, which is
+  // what the pretty query param does for debugging
+  static void writeJsonHttpResponse(const json::Object& obj, pion::net::HTTPResponseWriter& writer, const bool setStatusOK=true, const bool pretty=false);
+  static bool prettyJsonRequested(const pion::net::HTTPRequestPtr& request);
+  static void writeJsonErrorResponse(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection, const unsigned int statusCode, const std::string& statusMessage, const std::string& errorMessage);
 
 private:
+  // the result columns of the view that can be searched on
+  bool searchKeys(std::vector<std::string>& keys, std::string& errorMessage) const;
+  void expand(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection, const SanitizedParams& sq, const PageParams& page);
+  // answers the request without running the statements if the client's copy of the response is
+  // current, with a 304, or if the response cache holds the current response. that is compressed
+  // with the coding unless it's empty. otherwise returns false, with the etag and generation of the
+  // uncompressed response set unless the etag is left empty
+  bool writeCurrentResponse(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection, const std::vector<std::string>& statements, const std::string& key, const std::string& contentType, const std::string& coding, std::string& etag, boost::uint64_t& generation) const;
+  // hands the db work of a response to the executor, or does it right away without one. a
+  // request that finds the executor's queue full is answered with a 503 instead
+  void runQueries(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection, const DBExecutor::Work& work);
+
   const DBPtr _db;
   const std::string _source;
+  size_t _chunkSize;
+  int _compressionLevel;
+  boost::shared_ptr<ResponseCache> _responses;
+  boost::shared_ptr<DBExecutor> _executor;
 };
@@ -0,0 +1,66 @@
+#pragma once
+#include "Conf.h"
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <list>
+#include <map>
+#include <string>
+
+// a bounded, least recently used cache of serialized response bodies. every body is stored
+// along with the generation of the data it was made from, and is only handed out for that
+// generation. bodies made from older data are dropped once they are looked up again, or
+// fall out of the cache as newer ones are put in. capacity is the total size of the bodies.
+// a body can have variants made from it, e.g. compressed ones, which are kept in the same
+// entry and go along with it
+
+class ResponseCache : private boost::noncopyable {
+public:
+  typedef boost::shared_ptr<const std::string> Body;
+
+  struct Stats {
+    Stats() : size(0), capacity(0), entries(0), variants(0), hits(0), misses(0) {}
+    size_t size;
+    size_t capacity;
+    size_t entries;
+    size_t variants;
+    unsigned long hits;
+    unsigned long misses;
+  };
+
+  ResponseCache(const size_t capacity = RESPONSE_CACHE_SIZE);
+  // the body cached under the key for the given generation, or null
+  Body find(const std::string& key, const boost::uint64_t generation);
+  void insert(const std::string& key, const boost::uint64_t generation, const Body& body);
+  // a variant of the body cached under the key, or null. unlike find, this doesn't count as a
+  // hit or miss, the body it was made from has been looked up already
+  Body findVariant(const std::string& key, const boost::uint64_t generation, const std::string& variant);
+  // variants are only kept if the body for the same generation is still cached
+  void insertVariant(const std::string& key, const boost::uint64_t generation, const std::string& variant, const Body& body);
+  Stats stats() const;
+
+private:
+  struct Entry {
+    Entry(const std::string& k, const boost::uint64_t g, const Body& b) : key(k), generation(g), body(b), size(b->size()) {}
+    std::string key;
+    boost::uint64_t generation;
+    Body body;
+    std::map<std::string,Body> variants;
+    size_t size; // of the body and its variants
+  };
+  typedef std::list<Entry> Entries; // most recently used first
+  typedef std::map<std::string,Entries::iterator> Index;
+
+  void erase(const Index::iterator& it);
+  void evict();
+
+  const size_t _capacity;
+  mutable boost::mutex _mutex;
+  Entries _entries;
+  Index _index;
+  size_t _size;
+  size_t _variants;
+  unsigned long _hits;
+  unsigned long _misses;
+};
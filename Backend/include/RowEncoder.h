@@ -0,0 +1,48 @@
+#pragma once
+#include "DB.h"
+#include "BufferPool.h"
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+// serializes query results straight into pooled output buffers as they come off the db. every
+// encoding produces the same document: the rows in a content array, the cursor of the next page
+// if the results are paged and the error. the layout of that document is versioned, clients get
+// the version with every response
+
+class RowEncoder : private boost::noncopyable {
+public:
+  typedef std::vector<BufferPool::BufferPtr> Buffers;
+
+  // bumped whenever the document changes in a way that older clients can't read
+  static const unsigned int FORMAT_VERSION = 1;
+
+  RowEncoder(BufferPool& pool);
+  virtual ~RowEncoder();
+  virtual void begin() = 0;
+  virtual void row(const ResultRow& row);
+  // rows can be nested by opening an array member in a row, which the rows encoded until the
+  // array is closed go into
+  virtual void openRow(const ResultRow& row) = 0;
+  virtual void openArray(const std::string& name) = 0;
+  virtual void closeArray() = 0;
+  virtual void closeRow() = 0;
+  // a null error is encoded as null
+  virtual void end(const std::string* error = 0) = 0;
+  // ends a page of results, next being the cursor of the following page or null on the last one
+  virtual void end(const std::string* error, const std::string* next) = 0;
+  // drops everything encoded so far
+  void clear();
+  // moves the buffers encoded so far into out, to be sent while encoding carries on
+  void takeBuffers(Buffers& out);
+  const Buffers& buffers() const;
+  size_t size() const;
+
+protected:
+  void append(const char* data, const size_t size);
+  void append(const char c);
+
+private:
+  BufferPool& _pool;
+  Buffers _buffers;
+  size_t _size;
+};
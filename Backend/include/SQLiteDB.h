@@ -1,17 +1,71 @@
 #pragma once
 #include "DB.h"
+#include "SQLiteStatementCache.h"
+#include "SQLiteWriteQueue.h"
 #include <sqlite3.h>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <set>
+#include <vector>
 
 class SQLiteDB : public DB {
 public:
-  SQLiteDB();
-  ~SQLiteDB();
+  // an index kept up to date by ensureIndexes, columns being the column list it is created on
+  struct Index {
+    Index(const std::string& n, const std::string& c) : name(n), columns(c) {}
+    std::string name;
+    std::string columns;
+  };
+
+  SQLiteDB(const size_t writeBatchSize = WRITE_BATCH_SIZE, const size_t writeBatchLatency = WRITE_BATCH_LATENCY, const bool walMode = false);
+  virtual ~SQLiteDB();
+  // statements without a callback are handed to the write queue and waited for
   virtual bool execute(const std::string& query, std::string& errorMessage, const ExecuteCallback& callback, const SanitizedParams& sp = SanitizedParams()) const;
+  virtual CursorPtr openCursor(const std::string& query, std::string& errorMessage, const SanitizedParams& sp = SanitizedParams(), const PageParams& page = PageParams()) const;
+  virtual void queueWrite(const std::string& statement, const WriteCallback& callback = WriteCallback()) const;
+  virtual void waitForQueuedWrites() const;
   virtual JSONObjectPtr select(const std::string& fromSource) const;
   virtual JSONObjectPtr selectWhere(
 				    const std::string& fromSource, 
 				    const std::pair<const std::string,const std::string>& query) const;
+  virtual SQLiteStatementCache::Stats statementCacheStats() const;
+  SQLiteWriteQueue::Stats writeQueueStats() const;
+  // creates the indexes of a table. the definitions of the indexes created this way are kept in
+  // schema_indexes, so indexes that have changed are rebuilt and ones no longer given are dropped
+  bool ensureIndexes(const std::string& table, const std::vector<Index>& indexes, std::string& errorMessage) const;
+  // the names of the columns a query returns
+  bool columnNames(const std::string& query, std::vector<std::string>& names, std::string& errorMessage) const;
+  // the detail lines of the query's plan with the params and page bound to it, for every
+  // statement the page is read with
+  bool explainQueryPlan(const std::string& query, const SanitizedParams& sp, const PageParams& page, std::vector<std::string>& details, std::string& errorMessage) const;
+  // every table has a generation that goes up once a batch of writes changing it is committed.
+  // the generation of a query adds up those of the tables it reads, so it goes up as well
+  // whenever anything its results are made of changes
+  bool generation(const std::string& query, boost::uint64_t& generation, std::string& errorMessage) const;
+
+protected:
+  // called on the writer thread for every row the writer connection changes, for every table
+  // that is altered or dropped, and after every batch of writes has been committed or rolled
+  // back. overrides have to call these to keep the generations going
+  virtual void rowWritten(const std::string& table, const boost::int64_t rowid);
+  virtual void tableChanged(const std::string& table);
+  virtual void batchWritten();
+  // opens a cursor on a statement checked out of the given connection's statement cache
+  static CursorPtr openCachedCursor(sqlite3* db, SQLiteStatementCache& statements, const std::string& query, std::string& errorMessage, const SanitizedParams& sp, const PageParams& page);
 
 private:
+  bool tablesRead(const std::string& query, std::vector<std::string>& tables, std::string& errorMessage) const;
+  static void updateHook(void* self, int operation, const char* database, const char* table, sqlite3_int64 rowid);
+  static int authorize(void* self, int action, const char* arg1, const char* arg2, const char* database, const char* trigger);
+
   sqlite3* _db;
+  boost::scoped_ptr<SQLiteStatementCache> _statements;
+  boost::scoped_ptr<SQLiteWriteQueue> _writes;
+  mutable boost::mutex _generationsMutex;
+  std::map<std::string,boost::uint64_t> _generations;
+  std::set<std::string> _written; // tables changed since the last batch
+  std::string _dropping; // the table a drop statement is being compiled for
+  mutable std::map<std::string,std::vector<std::string> > _queryTables; // read by a query
 };
@@ -0,0 +1,37 @@
+#pragma once
+#include "SQLiteDB.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <vector>
+
+// a sqlite db that puts the cache into WAL mode and gives every thread running queries
+// its own read-only connection, so reads never wait for each other or for a writer.
+// cursors stay on the connection of the thread that opened them, wherever they're resumed.
+// everything that doesn't return rows goes through SQLiteDB's write queue.
+
+class SQLitePoolDB : public SQLiteDB {
+public:
+  SQLitePoolDB(const size_t writeBatchSize = WRITE_BATCH_SIZE, const size_t writeBatchLatency = WRITE_BATCH_LATENCY);
+  virtual ~SQLitePoolDB();
+  virtual CursorPtr openCursor(const std::string& query, std::string& errorMessage, const SanitizedParams& sp = SanitizedParams(), const PageParams& page = PageParams()) const;
+  virtual SQLiteStatementCache::Stats statementCacheStats() const;
+  size_t readerCount() const;
+
+private:
+  struct Reader {
+    Reader();
+    ~Reader();
+    sqlite3* _db;
+    boost::scoped_ptr<SQLiteStatementCache> _statements;
+  };
+  typedef boost::shared_ptr<Reader> ReaderPtr;
+
+  Reader& reader() const;
+  static void leaveReaderToPool(Reader*);
+
+  // readers are owned by _readers, the thread local slot only points at them
+  mutable boost::thread_specific_ptr<Reader> _threadReader;
+  mutable boost::mutex _readersMutex;
+  mutable std::vector<ReaderPtr> _readers;
+};
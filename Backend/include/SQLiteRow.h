@@ -0,0 +1,48 @@
+#pragma once
+#include "DB.h"
+#include <sqlite3.h>
+
+// ResultRow over a statement that has just returned SQLITE_ROW. values are read straight
+// from the statement, so nothing is copied or converted unless the caller asks for it
+
+class SQLiteRow : public ResultRow {
+public:
+  SQLiteRow(sqlite3_stmt* stmt) : _stmt(stmt), _colCount(sqlite3_column_count(stmt)) {}
+
+  virtual int columnCount() const {
+    return _colCount;
+  }
+
+  virtual const char* columnName(const int column) const {
+    return sqlite3_column_name(_stmt,column);
+  }
+
+  virtual ColumnType columnType(const int column) const {
+    switch (sqlite3_column_type(_stmt,column)) {
+    case SQLITE_INTEGER: return Integer;
+    case SQLITE_FLOAT: return Float;
+    case SQLITE_NULL: return Null;
+    default: return Text; // blobs are handed out as text
+    }
+  }
+
+  virtual boost::int64_t integerValue(const int column) const {
+    return sqlite3_column_int64(_stmt,column);
+  }
+
+  virtual double floatValue(const int column) const {
+    return sqlite3_column_double(_stmt,column);
+  }
+
+  virtual TextValue textValue(const int column) const {
+    TextValue v;
+    // the pointer has to be fetched before the size, see the sqlite docs on sqlite3_column_bytes
+    v.data = reinterpret_cast<const char*>(sqlite3_column_text(_stmt,column));
+    v.size = sqlite3_column_bytes(_stmt,column);
+    return v;
+  }
+
+private:
+  sqlite3_stmt* const _stmt;
+  const int _colCount;
+};
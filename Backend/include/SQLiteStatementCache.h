@@ -0,0 +1,46 @@
+#pragma once
+#include "Conf.h"
+#include <sqlite3.h>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <list>
+#include <map>
+#include <string>
+
+// a bounded, least recently used cache of prepared statements belonging to a single
+// sqlite connection. statements are checked out with acquire() while they're being
+// stepped and handed back with release(), so the same statement is never used by
+// two callers at once. only idle statements count towards the cache size.
+
+class SQLiteStatementCache : private boost::noncopyable {
+public:
+  struct Stats {
+    Stats() : size(0), capacity(0), hits(0), misses(0) {}
+    size_t size;
+    size_t capacity;
+    unsigned long hits;
+    unsigned long misses;
+  };
+
+  SQLiteStatementCache(sqlite3* db, const size_t capacity = STATEMENT_CACHE_SIZE);
+  ~SQLiteStatementCache();
+  // returns a ready to bind statement for the given key. sql is only compiled if there is
+  // no idle statement cached under that key. returns 0 and sets errorMessage on failure
+  sqlite3_stmt* acquire(const std::string& key, const std::string& sql, std::string& errorMessage);
+  // resets the statement and makes it available to the next acquire() with the same key
+  void release(const std::string& key, sqlite3_stmt* stmt);
+  Stats stats() const;
+
+private:
+  typedef std::pair<std::string,sqlite3_stmt*> Entry;
+  typedef std::list<Entry> Entries; // most recently used first
+  typedef std::map<std::string,Entries::iterator> Index;
+
+  sqlite3* const _db;
+  const size_t _capacity;
+  mutable boost::mutex _mutex;
+  Entries _idle;
+  Index _index;
+  unsigned long _hits;
+  unsigned long _misses;
+};
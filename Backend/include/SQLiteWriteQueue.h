@@ -0,0 +1,69 @@
+#pragma once
+#include "Conf.h"
+#include <sqlite3.h>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <string>
+
+// funnels every write to a sqlite connection through a single thread. queued statements
+// are committed together in one transaction per batch; a batch is closed once it holds
+// maxBatchSize statements or maxLatency has passed since its first statement was queued.
+// each statement runs inside its own savepoint, so one failing statement doesn't take the
+// rest of its batch down with it. completion callbacks are invoked on the writer thread
+// after the batch has been committed and should return quickly.
+
+class SQLiteWriteQueue : private boost::noncopyable {
+public:
+  typedef boost::function<void (bool, const std::string&)> CompletionCallback;
+  typedef boost::function<void ()> BatchCallback;
+
+  struct Stats {
+    Stats() : pending(0), batches(0), statements(0), failures(0) {}
+    size_t pending;
+    unsigned long batches;
+    unsigned long statements;
+    unsigned long failures;
+  };
+
+  SQLiteWriteQueue(sqlite3* db, const size_t maxBatchSize = WRITE_BATCH_SIZE, const boost::posix_time::time_duration& maxLatency = boost::posix_time::milliseconds(WRITE_BATCH_LATENCY));
+  // commits everything still queued before returning
+  ~SQLiteWriteQueue();
+  void enqueue(const std::string& statement, const CompletionCallback& callback = CompletionCallback());
+  // queues the statement and blocks until the batch containing it has been committed
+  bool execute(const std::string& statement, std::string& errorMessage);
+  // blocks until everything queued so far has been committed
+  void flush();
+  Stats stats() const;
+  // invoked on the writer thread after every batch has been committed or rolled back, before
+  // the completion callbacks of its statements, so it may still use the connection
+  void setBatchCallback(const BatchCallback& callback);
+
+private:
+  struct Write {
+    Write(const std::string& statement, const CompletionCallback& callback) : _statement(statement), _callback(callback) {}
+    std::string _statement;
+    CompletionCallback _callback;
+  };
+  typedef std::deque<Write> Writes;
+
+  void run();
+  void commit(Writes& batch);
+  bool exec(const std::string& statement, std::string& errorMessage);
+
+  sqlite3* const _db;
+  const size_t _maxBatchSize;
+  const boost::posix_time::time_duration _maxLatency;
+  mutable boost::mutex _mutex;
+  boost::condition_variable _wakeup;
+  Writes _pending;
+  bool _stopping;
+  Stats _stats;
+  BatchCallback _batchCallback;
+  boost::scoped_ptr<boost::thread> _thread;
+};
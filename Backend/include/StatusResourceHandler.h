@@ -0,0 +1,10 @@
+#pragma once
+#include "ResourceHandler.h"
+
+// reports runtime statistics about the backend, e.g. how well the statement cache is doing
+
+class StatusResourceHandler : public ResourceHandler {
+public:
+  StatusResourceHandler(const DBPtr db);
+  virtual void handle(pion::net::HTTPRequestPtr&,pion::net::TCPConnectionPtr&);
+};
@@ -9,4 +9,5 @@ protected:
   virtual std::string listStatement() const;
   virtual SanitizedParams sanitizeQueryParams(const pion::net::HTTPTypes::QueryParams& dirtyParams) const;
   virtual std::string viewStatement() const;
+  virtual bool expansion(const std::string& expand, std::vector<Expansion>& levels) const;
 };
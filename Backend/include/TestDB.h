@@ -1,20 +1,62 @@
 #pragma once
 #include "DB.h"
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <map>
+#include <vector>
 
-// a mock database that stores JSON data internally
+namespace json { class Parser; }
+
+// a mock database that serves the JSON document <source>.json. the file is mapped into
+// memory and parsed once, keeping only where each item of its "content" array lies in the
+// file and the values of the items' string members. filtering on a member builds a hash
+// index of its values the first time, and only the matching items are turned into elements
 
 class TestDB : public DB {
 public:
   TestDB(const std::string& source, const bool createDoc=true);
+  virtual ~TestDB();
   // note: these queries ONLY respond to the given source in order to simulate having a real table in a real db
   virtual JSONObjectPtr select(const std::string& fromSource) const;
   virtual JSONObjectPtr selectWhere(
-				    const std::string& fromSource, 
+				    const std::string& fromSource,
 				    const std::pair<const std::string,const std::string>& query) const;
 
 protected:
   JSONObjectPtr doc() const;
 private:
-  JSONObjectPtr _doc;
+  struct Item {
+    size_t begin, end; // of its text in the file
+    size_t firstMember; // in _members, up to the next item's
+  };
+  struct Member {
+    boost::uint32_t key; // in _keys
+    boost::uint32_t size;
+    size_t offset; // of the value in _text
+  };
+  // from the hash of a value to the items holding it
+  typedef boost::unordered_multimap<size_t,size_t> Index;
+  typedef boost::shared_ptr<const Index> IndexPtr;
+
+  void map(const std::string& fileName);
+  void load();
+  void loadItems(json::Parser& parser);
+  boost::uint32_t keyId(const std::string& key);
+  IndexPtr index(const boost::uint32_t key) const;
+
+  const bool _createDoc;
   const std::string _source;
+  const char* _file;
+  size_t _fileSize;
+  std::string _loadError;
+  std::vector<Item> _items;
+  std::vector<Member> _members; // string members only
+  std::string _text; // the decoded values of string members
+  std::map<std::string,boost::uint32_t> _keys;
+
+  mutable boost::mutex _mutex;
+  mutable JSONObjectPtr _doc;
+  mutable std::map<boost::uint32_t,IndexPtr> _indexes;
 };
@@ -0,0 +1,44 @@
+#include "BufferPool.h"
+
+BufferPool::Freelist::~Freelist() {
+  std::vector<Buffer*>::iterator it(_idle.begin());
+  const std::vector<Buffer*>::iterator end(_idle.end());
+  for (; it!=end; ++it)
+    delete *it;
+}
+
+void BufferPool::Recycler::operator()(Buffer* buffer) const {
+  {
+    boost::mutex::scoped_lock lock(_freelist->_mutex);
+    if (_freelist->_idle.size() < _freelist->_maxIdle) {
+      buffer->_size = 0;
+      _freelist->_idle.push_back(buffer);
+      return;
+    }
+  }
+  delete buffer;
+}
+
+BufferPool::BufferPool(const size_t bufferSize, const size_t maxIdle)
+  : _bufferSize(bufferSize)
+  , _freelist(new Freelist(maxIdle)) {
+  assert(_bufferSize > 0);
+}
+
+BufferPool::BufferPtr BufferPool::acquire() {
+  Buffer* buffer(0);
+  {
+    boost::mutex::scoped_lock lock(_freelist->_mutex);
+    if (!_freelist->_idle.empty()) {
+      buffer = _freelist->_idle.back();
+      _freelist->_idle.pop_back();
+    }
+  }
+  if (!buffer)
+    buffer = new Buffer(_bufferSize);
+  return BufferPtr(buffer,Recycler(_freelist));
+}
+
+size_t BufferPool::bufferSize() const {
+  return _bufferSize;
+}
@@ -0,0 +1,181 @@
+#include "CBORRowEncoder.h"
+#include <cfloat>
+#include <cstring>
+
+namespace {
+  // major types, in the top three bits of an item's first byte
+  const unsigned char unsignedType(0);
+  const unsigned char negativeType(1);
+  const unsigned char textType(3);
+  const unsigned char mapType(5);
+
+  const char indefiniteArray('\x9f');
+  const char indefiniteMap('\xbf');
+  const char breakCode('\xff');
+  const char nullValue('\xf6');
+  const char singleFloat('\xfa');
+  const char doubleFloat('\xfb');
+
+  // the initial byte of an item and its argument, big endian in as few bytes as it fits into.
+  // returns how many of the up to 9 bytes were written
+  size_t encodeHead(char* head, const unsigned char majorType, const boost::uint64_t value) {
+    const char type(static_cast<char>(majorType << 5));
+    if (value < 24) {
+      head[0] = static_cast<char>(type | value);
+      return 1;
+    }
+    size_t bytes(8);
+    if (value <= 0xff)
+      bytes = 1;
+    else if (value <= 0xffff)
+      bytes = 2;
+    else if (value <= 0xffffffffu)
+      bytes = 4;
+    // 24 to 27 announce an argument of 1, 2, 4 and 8 bytes
+    head[0] = static_cast<char>(type | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27));
+    for (size_t i(0); i<bytes; ++i)
+      head[bytes-i] = static_cast<char>(value >> (8*i));
+    return bytes+1;
+  }
+}
+
+CBORRowEncoder::CBORRowEncoder(BufferPool& pool)
+  : RowEncoder(pool)
+  , _depth(0) {
+}
+
+void CBORRowEncoder::begin() {
+  append(indefiniteMap);
+  appendString("content",7);
+  append(indefiniteArray);
+  _depth = 0;
+}
+
+// a row without nested arrays knows how many members it has up front
+void CBORRowEncoder::row(const ResultRow& row) {
+  appendHead(mapType,row.columnCount());
+  appendColumns(row);
+}
+
+void CBORRowEncoder::openRow(const ResultRow& row) {
+  append(indefiniteMap);
+  appendColumns(row);
+}
+
+void CBORRowEncoder::closeRow() {
+  append(breakCode);
+}
+
+void CBORRowEncoder::openArray(const std::string& name) {
+  appendString(name.data(),name.size());
+  append(indefiniteArray);
+  ++_depth;
+}
+
+void CBORRowEncoder::closeArray() {
+  assert(_depth > 0);
+  append(breakCode);
+  --_depth;
+}
+
+void CBORRowEncoder::end(const std::string* error) {
+  append(breakCode);
+  appendString("error",5);
+  appendNullableString(error);
+  append(breakCode);
+}
+
+void CBORRowEncoder::end(const std::string* error, const std::string* next) {
+  append(breakCode);
+  appendString("next",4);
+  appendNullableString(next);
+  appendString("error",5);
+  appendNullableString(error);
+  append(breakCode);
+}
+
+void CBORRowEncoder::appendColumns(const ResultRow& row) {
+  const int colCount(row.columnCount());
+  if (_keys.size() <= _depth)
+    _keys.resize(_depth+1);
+  std::vector<std::string>& keys(_keys[_depth]);
+  if (keys.empty()) {
+    keys.reserve(colCount);
+    for (int i(0); i<colCount; ++i) {
+      const char* const name(row.columnName(i));
+      assert(name);
+      // column names are encoded once per query
+      const size_t size(strlen(name));
+      char head[9];
+      std::string key(head,encodeHead(head,textType,size));
+      key.append(name,size);
+      keys.push_back(key);
+    }
+  }
+  assert(static_cast<int>(keys.size()) == colCount);
+  for (int i(0); i<colCount; ++i) {
+    append(keys[i].data(),keys[i].size());
+    switch (row.columnType(i)) {
+    case ResultRow::Integer:
+      appendInteger(row.integerValue(i));
+      break;
+    case ResultRow::Float:
+      appendFloat(row.floatValue(i));
+      break;
+    case ResultRow::Text: {
+      const ResultRow::TextValue value(row.textValue(i));
+      appendString(value.data,value.size);
+      break;
+    }
+    default:
+      append(nullValue);
+    }
+  }
+}
+
+void CBORRowEncoder::appendHead(const unsigned char majorType, const boost::uint64_t value) {
+  char head[9];
+  append(head,encodeHead(head,majorType,value));
+}
+
+void CBORRowEncoder::appendString(const char* data, const size_t size) {
+  appendHead(textType,size);
+  append(data,size);
+}
+
+void CBORRowEncoder::appendNullableString(const std::string* value) {
+  if (value)
+    appendString(value->data(),value->size());
+  else
+    append(nullValue);
+}
+
+void CBORRowEncoder::appendInteger(const boost::int64_t value) {
+  // negative integers are encoded as -1 minus their argument, which is the value's complement
+  if (value < 0)
+    appendHead(negativeType,~static_cast<boost::uint64_t>(value));
+  else
+    appendHead(unsignedType,static_cast<boost::uint64_t>(value));
+}
+
+void CBORRowEncoder::appendFloat(const double value) {
+  char encoded[9];
+  // nan and infinity fit into single precision just as well as anything that doesn't lose digits
+  const bool special(value != value || value - value != 0);
+  if (special || (value >= -FLT_MAX && value <= FLT_MAX && static_cast<float>(value) == value)) {
+    const float single(static_cast<float>(value));
+    boost::uint32_t bits;
+    memcpy(&bits,&single,sizeof(bits));
+    encoded[0] = singleFloat;
+    for (int i(0); i<4; ++i)
+      encoded[4-i] = static_cast<char>(bits >> (8*i));
+    append(encoded,5);
+  } else {
+    boost::uint64_t bits;
+    memcpy(&bits,&value,sizeof(bits));
+    encoded[0] = doubleFloat;
+    for (int i(0); i<8; ++i)
+      encoded[8-i] = static_cast<char>(bits >> (8*i));
+    append(encoded,9);
+  }
+}
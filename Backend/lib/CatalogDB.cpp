@@ -0,0 +1,214 @@
+#include "CatalogDB.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <sstream>
+
+CatalogDB::CatalogDB(const size_t writeBatchSize, const size_t writeBatchLatency)
+  : SQLitePoolDB(writeBatchSize,writeBatchLatency) {
+}
+
+CatalogDB::~CatalogDB() {
+  // the writer calls back into the catalog until everything queued has been written
+  waitForQueuedWrites();
+}
+
+namespace {
+  bool isIdentifier(const std::string& s) {
+    if (s.empty())
+      return false;
+    for (std::string::const_iterator c(s.begin()); c!=s.end(); ++c) {
+      if (!isalnum(static_cast<unsigned char>(*c)) && *c != '_')
+	return false;
+    }
+    return true;
+  }
+
+  std::vector<std::string> words(const std::string& s) {
+    std::vector<std::string> w;
+    std::istringstream ss(s);
+    std::string word;
+    while (ss >> word)
+      w.push_back(word);
+    return w;
+  }
+
+  PageParams rowidOrder() {
+    PageParams order;
+    order.keyColumn = "rowid";
+    return order;
+  }
+}
+
+bool CatalogDB::cacheView(const std::string& viewStatement, const std::vector<std::string>& indexedColumns, std::string& errorMessage) {
+  const std::string select("select "), from(" from ");
+  const std::string::size_type fromPos(viewStatement.find(from));
+  const std::string tableName(fromPos == std::string::npos ? std::string() : viewStatement.substr(fromPos+from.size()));
+  if (viewStatement.compare(0,select.size(),select) != 0 || !isIdentifier(tableName)) {
+    errorMessage = "can't keep a view in memory that doesn't select from a single table: " + viewStatement;
+    return false;
+  }
+  Table table;
+  std::string columns;
+  std::istringstream list(viewStatement.substr(select.size(),fromPos-select.size()));
+  std::string item;
+  while (std::getline(list,item,',')) {
+    const std::vector<std::string> w(words(item));
+    if (!((w.size() == 1 || (w.size() == 3 && w[1] == "as")) && isIdentifier(w.front()))) {
+      errorMessage = "can't keep a view in memory that selects more than plain columns: " + viewStatement;
+      return false;
+    }
+    const bool indexed(std::find(indexedColumns.begin(),indexedColumns.end(),w.front()) != indexedColumns.end());
+    table.columns.push_back(CatalogTable::Column(w.front(),w.back(),indexed));
+    columns += ", " + w.front();
+  }
+  table.selectStatement = "select rowid" + columns + " from " + tableName;
+  {
+    // registered before loading, so that rows written in the meantime are read back later on
+    boost::mutex::scoped_lock lock(_mutex);
+    if (_tables.count(tableName)) {
+      errorMessage = "the table behind " + viewStatement + " is already kept in memory";
+      return false;
+    }
+    _tables[tableName] = table;
+  }
+  const CursorPtr rows(SQLiteDB::openCursor(table.selectStatement,errorMessage,SanitizedParams(),rowidOrder()));
+  const CatalogTable::Ptr loaded(rows ? CatalogTable::load(table.columns,*rows) : CatalogTable::Ptr());
+  boost::mutex::scoped_lock lock(_mutex);
+  if (!loaded || rows->failed(errorMessage)) {
+    _tables.erase(tableName);
+    return false;
+  }
+  _tables[tableName].rows = loaded;
+  _views[viewStatement] = tableName;
+  _views[viewStatement + ";"] = tableName; // the list statement
+  return true;
+}
+
+CatalogTable::Ptr CatalogDB::cachedRows(const std::string& query) const {
+  boost::mutex::scoped_lock lock(_mutex);
+  const std::map<std::string,std::string>::const_iterator view(_views.find(query));
+  if (view == _views.end())
+    return CatalogTable::Ptr();
+  return _tables.find(view->second)->second.rows;
+}
+
+CursorPtr CatalogDB::openCursor(const std::string& query, std::string& errorMessage, const SanitizedParams& sp, const PageParams& page) const {
+  if (page.empty()) {
+    const CatalogTable::Ptr rows(cachedRows(query));
+    const CursorPtr cursor(rows ? rows->select(sp) : CursorPtr());
+    if (cursor) {
+      boost::mutex::scoped_lock lock(_mutex);
+      ++_stats.hits;
+      return cursor;
+    }
+  }
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    ++_stats.misses;
+  }
+  return SQLitePoolDB::openCursor(query,errorMessage,sp,page);
+}
+
+// runs on the writer thread after every batch. the rows are read back through the writer
+// connection, which sees its own writes no matter what the readers have caught up with
+void CatalogDB::refresh() {
+  std::map<std::string,std::set<boost::int64_t> > changed;
+  std::set<std::string> reload;
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    changed.swap(_changed);
+    reload.swap(_reload);
+  }
+  std::set<std::string> tables(reload);
+  std::map<std::string,std::set<boost::int64_t> >::const_iterator it(changed.begin());
+  for (; it!=changed.end(); ++it)
+    tables.insert(it->first);
+  std::set<std::string>::const_iterator name(tables.begin());
+  for (; name!=tables.end(); ++name) {
+    Table table;
+    {
+      boost::mutex::scoped_lock lock(_mutex);
+      table = _tables[*name];
+    }
+    const std::set<boost::int64_t>& rowids(changed[*name]);
+    if (!table.rows) {
+      // still loading, the rows are read back once the load is done
+      boost::mutex::scoped_lock lock(_mutex);
+      _changed[*name].insert(rowids.begin(),rowids.end());
+      continue;
+    }
+    std::string errMsg;
+    CursorPtr rows;
+    CatalogTable::Ptr updated;
+    if (reload.count(*name) || rowids.size() > CATALOG_RELOAD_SIZE) {
+      rows = SQLiteDB::openCursor(table.selectStatement,errMsg,SanitizedParams(),rowidOrder());
+      if (rows)
+	updated = CatalogTable::load(table.columns,*rows);
+    } else {
+      SanitizedParams sp;
+      std::set<boost::int64_t>::const_iterator rowid(rowids.begin());
+      for (; rowid!=rowids.end(); ++rowid) {
+	std::ostringstream ss;
+	ss << *rowid;
+	sp.insert(std::make_pair("rowid",SanitizedParam(ss.str(),SanitizedParam::Integer)));
+      }
+      rows = SQLiteDB::openCursor(table.selectStatement,errMsg,sp,rowidOrder());
+      if (rows)
+	updated = table.rows->update(*rows,rowids);
+    }
+    boost::mutex::scoped_lock lock(_mutex);
+    if (!rows || rows->failed(errMsg)) {
+      // serving stale rows is worse than not serving them from memory at all
+      std::cerr << "Unable to refresh the in-memory copy of " << *name << ", leaving it to sqlite. Reason: " << errMsg << std::endl;
+      std::map<std::string,std::string>::iterator view(_views.begin());
+      while (view!=_views.end()) {
+	if (view->second == *name)
+	  _views.erase(view++);
+	else
+	  ++view;
+      }
+      _tables.erase(*name);
+      continue;
+    }
+    _tables[*name].rows = updated;
+    ++_stats.refreshes;
+  }
+}
+
+void CatalogDB::rowWritten(const std::string& table, const boost::int64_t rowid) {
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    if (_tables.count(table))
+      _changed[table].insert(rowid);
+  }
+  SQLitePoolDB::rowWritten(table,rowid);
+}
+
+void CatalogDB::tableChanged(const std::string& table) {
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    if (_tables.count(table))
+      _reload.insert(table);
+  }
+  SQLitePoolDB::tableChanged(table);
+}
+
+// the new copies are in place before the generations go up
+void CatalogDB::batchWritten() {
+  refresh();
+  SQLitePoolDB::batchWritten();
+}
+
+CatalogDB::Stats CatalogDB::catalogStats() const {
+  boost::mutex::scoped_lock lock(_mutex);
+  Stats s(_stats);
+  Tables::const_iterator it(_tables.begin());
+  for (; it!=_tables.end(); ++it) {
+    if (it->second.rows) {
+      ++s.tables;
+      s.rows += it->second.rows->size();
+    }
+  }
+  return s;
+}
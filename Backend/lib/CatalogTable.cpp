@@ -0,0 +1,262 @@
+#include "CatalogTable.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// the values of one row of a table, as handed out by its cursors
+class CatalogTable::Row : public ResultRow {
+public:
+  Row(const CatalogTable& table) : _table(table), _slot(0) {}
+
+  void moveTo(const size_t slot) {
+    _slot = slot;
+  }
+
+  virtual int columnCount() const {
+    return _table._columns.size();
+  }
+
+  virtual const char* columnName(const int column) const {
+    return _table._columns[column].alias.c_str();
+  }
+
+  virtual ColumnType columnType(const int column) const {
+    return static_cast<ColumnType>(_table._data[column].types[_slot]);
+  }
+
+  virtual boost::int64_t integerValue(const int column) const {
+    return _table._data[column].values[_slot];
+  }
+
+  virtual double floatValue(const int column) const {
+    double value;
+    memcpy(&value,&_table._data[column].values[_slot],sizeof(value));
+    return value;
+  }
+
+  virtual TextValue textValue(const int column) const {
+    const ColumnData& data(_table._data[column]);
+    TextValue v;
+    v.data = data.text.data() + data.values[_slot];
+    v.size = data.sizes[_slot];
+    return v;
+  }
+
+private:
+  const CatalogTable& _table;
+  size_t _slot;
+};
+
+// walks the candidate rows of a select, either all of them or the ones an index lookup found,
+// and skips those not matching the remaining params
+class CatalogTable::Selection : public Cursor {
+public:
+  typedef std::vector<std::pair<size_t,std::vector<SanitizedParam> > > Filters;
+
+  Selection(const CatalogTable::Ptr& table, const bool all, const std::vector<size_t>& candidates, const Filters& filters)
+    : _table(table), _all(all), _candidates(candidates), _filters(filters), _next(0), _row(*table) {}
+
+  virtual bool next() {
+    const size_t end(_all ? _table->size() : _candidates.size());
+    while (_next < end) {
+      const size_t slot(_all ? _next : _candidates[_next]);
+      ++_next;
+      if (matches(slot)) {
+	_row.moveTo(slot);
+	return true;
+      }
+    }
+    return false;
+  }
+
+  virtual const ResultRow& row() const {
+    return _row;
+  }
+
+  virtual bool failed(std::string&) const {
+    return false;
+  }
+
+private:
+  bool matches(const size_t slot) const {
+    Filters::const_iterator filter(_filters.begin());
+    for (; filter!=_filters.end(); ++filter) {
+      bool any(false);
+      std::vector<SanitizedParam>::const_iterator value(filter->second.begin());
+      for (; value!=filter->second.end() && !any; ++value)
+	any = _table->matches(filter->first,slot,*value);
+      if (!any)
+	return false;
+    }
+    return true;
+  }
+
+  const CatalogTable::Ptr _table;
+  const bool _all;
+  const std::vector<size_t> _candidates;
+  const Filters _filters;
+  size_t _next;
+  Row _row;
+};
+
+CatalogTable::CatalogTable(const std::vector<Column>& columns)
+  : _columns(columns)
+  , _data(columns.size())
+  , _indexes(columns.size()) {
+}
+
+CatalogTable::Ptr CatalogTable::load(const std::vector<Column>& columns, Cursor& rows) {
+  const boost::shared_ptr<CatalogTable> table(new CatalogTable(columns));
+  while (rows.next())
+    table->append(rows.row());
+  table->buildIndexes();
+  return table;
+}
+
+CatalogTable::Ptr CatalogTable::update(Cursor& rows, const std::set<boost::int64_t>& changed) const {
+  const boost::shared_ptr<CatalogTable> table(new CatalogTable(_columns));
+  // both sides are in rowid order, so merging them keeps the new table in rowid order too
+  bool more(rows.next());
+  for (size_t slot(0); slot<_rowids.size(); ++slot) {
+    for (; more && rows.row().integerValue(0) < _rowids[slot]; more = rows.next())
+      table->append(rows.row());
+    if (!changed.count(_rowids[slot]))
+      table->append(*this,slot);
+  }
+  for (; more; more = rows.next())
+    table->append(rows.row());
+  table->buildIndexes();
+  return table;
+}
+
+void CatalogTable::append(const ResultRow& row) {
+  assert(row.columnCount() == static_cast<int>(_columns.size())+1);
+  _rowids.push_back(row.integerValue(0));
+  for (size_t i(0); i<_columns.size(); ++i) {
+    ColumnData& data(_data[i]);
+    const ResultRow::ColumnType type(row.columnType(i+1));
+    boost::int64_t value(0);
+    size_t size(0);
+    switch (type) {
+    case ResultRow::Integer:
+      value = row.integerValue(i+1);
+      break;
+    case ResultRow::Float: {
+      const double f(row.floatValue(i+1));
+      memcpy(&value,&f,sizeof(value));
+      break;
+    }
+    case ResultRow::Text: {
+      const ResultRow::TextValue text(row.textValue(i+1));
+      value = data.text.size();
+      size = text.size;
+      data.text.append(text.data,text.size);
+      break;
+    }
+    default:
+      break;
+    }
+    data.types.push_back(type);
+    data.values.push_back(value);
+    data.sizes.push_back(size);
+  }
+}
+
+void CatalogTable::append(const CatalogTable& table, const size_t slot) {
+  _rowids.push_back(table._rowids[slot]);
+  for (size_t i(0); i<_columns.size(); ++i) {
+    const ColumnData& from(table._data[i]);
+    ColumnData& to(_data[i]);
+    boost::int64_t value(from.values[slot]);
+    if (from.types[slot] == ResultRow::Text) {
+      value = to.text.size();
+      to.text.append(from.text,from.values[slot],from.sizes[slot]);
+    }
+    to.types.push_back(from.types[slot]);
+    to.values.push_back(value);
+    to.sizes.push_back(from.sizes[slot]);
+  }
+}
+
+void CatalogTable::buildIndexes() {
+  for (size_t i(0); i<_columns.size(); ++i) {
+    if (!_columns[i].indexed)
+      continue;
+    const ColumnData& data(_data[i]);
+    Index& index(_indexes[i]);
+    index.rehash(_rowids.size());
+    for (size_t slot(0); slot<_rowids.size(); ++slot) {
+      if (data.types[slot] == ResultRow::Integer)
+	index.insert(std::make_pair(data.values[slot],slot));
+    }
+  }
+}
+
+// compares the way sqlite does for the params the handlers sanitize: integers by value, text
+// byte by byte, and null never matches
+bool CatalogTable::matches(const size_t column, const size_t slot, const SanitizedParam& param) const {
+  const ColumnData& data(_data[column]);
+  switch (data.types[slot]) {
+  case ResultRow::Integer: {
+    boost::int64_t value;
+    return param.integerValue(value) && value == data.values[slot];
+  }
+  case ResultRow::Float: {
+    double value;
+    memcpy(&value,&data.values[slot],sizeof(value));
+    const char* const begin(param.value.c_str());
+    char* end(0);
+    const double p(strtod(begin,&end));
+    return end != begin && *end == '\0' && p == value;
+  }
+  case ResultRow::Text:
+    return param.value.size() == data.sizes[slot] && param.value.compare(0,std::string::npos,data.text,data.values[slot],data.sizes[slot]) == 0;
+  default:
+    return false;
+  }
+}
+
+CursorPtr CatalogTable::select(const SanitizedParams& sp) const {
+  Selection::Filters filters;
+  int indexed(-1);
+  SanitizedParams::const_iterator it(sp.begin());
+  while (it!=sp.end()) {
+    const SanitizedParams::const_iterator next(sp.upper_bound(it->first));
+    size_t column(0);
+    while (column < _columns.size() && _columns[column].name != it->first)
+      ++column;
+    if (column == _columns.size())
+      return CursorPtr();
+    if (indexed < 0 && _columns[column].indexed)
+      indexed = filters.size();
+    filters.push_back(std::make_pair(column,std::vector<SanitizedParam>()));
+    for (; it!=next; ++it)
+      filters.back().second.push_back(it->second);
+  }
+  std::vector<size_t> candidates;
+  if (indexed >= 0) {
+    // one indexed param narrows the rows down, the others are checked on the candidates
+    const Index& index(_indexes[filters[indexed].first]);
+    std::vector<SanitizedParam>::const_iterator value(filters[indexed].second.begin());
+    for (; value!=filters[indexed].second.end(); ++value) {
+      boost::int64_t key;
+      if (!value->integerValue(key))
+	continue;
+      const std::pair<Index::const_iterator,Index::const_iterator> range(index.equal_range(key));
+      for (Index::const_iterator slot(range.first); slot!=range.second; ++slot)
+	candidates.push_back(slot->second);
+    }
+    std::sort(candidates.begin(),candidates.end());
+    candidates.erase(std::unique(candidates.begin(),candidates.end()),candidates.end());
+    filters.erase(filters.begin()+indexed);
+  }
+  return CursorPtr(new Selection(shared_from_this(),indexed < 0,candidates,filters));
+}
+
+size_t CatalogTable::size() const {
+  return _rowids.size();
+}
+
+const std::vector<CatalogTable::Column>& CatalogTable::columns() const {
+  return _columns;
+}
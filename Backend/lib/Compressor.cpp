@@ -0,0 +1,52 @@
+#include "Compressor.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+const std::string Compressor::GZIP("gzip");
+const std::string Compressor::DEFLATE("deflate");
+
+Compressor::Compressor(const std::string& coding, const int level) {
+  assert(coding == GZIP || coding == DEFLATE);
+  memset(&_stream,0,sizeof(_stream));
+  // the deflate coding is the zlib format, gzip asks for its own header and trailer instead
+  const int windowBits(coding == GZIP ? 15+16 : 15);
+  // with valid arguments, setting up can only fail for lack of memory
+  if (deflateInit2(&_stream,level,Z_DEFLATED,windowBits,8,Z_DEFAULT_STRATEGY) != Z_OK)
+    throw std::bad_alloc();
+}
+
+Compressor::~Compressor() {
+  deflateEnd(&_stream);
+}
+
+void Compressor::write(const char* data, const size_t size, std::string& out) {
+  _stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  _stream.avail_in = size;
+  deflate(Z_NO_FLUSH,out);
+}
+
+void Compressor::flush(std::string& out, const bool finish) {
+  _stream.next_in = 0;
+  _stream.avail_in = 0;
+  deflate(finish ? Z_FINISH : Z_SYNC_FLUSH,out);
+}
+
+// runs deflate until it has taken all of the input and, when flushing, put out all it has
+void Compressor::deflate(const int flush, std::string& out) {
+  size_t used(out.size());
+  while (true) {
+    if (out.size() - used < 1024)
+      out.resize(used + std::max<size_t>(deflateBound(&_stream,_stream.avail_in),16384));
+    _stream.next_out = reinterpret_cast<Bytef*>(&out[used]);
+    _stream.avail_out = out.size() - used;
+    const int result(::deflate(&_stream,flush));
+    used = out.size() - _stream.avail_out;
+    // with room left over, deflate is done with whatever it was asked to do. a stream error
+    // means it was used wrong
+    assert(result != Z_STREAM_ERROR);
+    if (result == Z_STREAM_END || result == Z_STREAM_ERROR || (_stream.avail_in == 0 && _stream.avail_out != 0))
+      break;
+  }
+  out.resize(used);
+}
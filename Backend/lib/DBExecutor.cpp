@@ -0,0 +1,77 @@
+#include "DBExecutor.h"
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace {
+  boost::posix_time::ptime now() {
+    return boost::posix_time::microsec_clock::universal_time();
+  }
+}
+
+DBExecutor::DBExecutor(const size_t threads, const size_t maxQueued)
+  : _maxQueued(maxQueued) {
+  assert(threads && maxQueued);
+  _stats.threads = threads;
+  _stats.capacity = _maxQueued;
+  _scheduler.setNumThreads(_stats.threads);
+  // starts the threads, which keep running until the executor is destroyed
+  _scheduler.addActiveUser();
+}
+
+DBExecutor::~DBExecutor() {
+  _scheduler.removeActiveUser();
+  _scheduler.shutdown();
+}
+
+bool DBExecutor::trySubmit(const Work& work) {
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    if (_stats.queued >= _maxQueued) {
+      ++_stats.rejected;
+      return false;
+    }
+    ++_stats.queued;
+  }
+  _scheduler.post(boost::bind(&DBExecutor::run, this, work, now()));
+  return true;
+}
+
+void DBExecutor::submit(const Work& work) {
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    ++_stats.queued;
+  }
+  _scheduler.post(boost::bind(&DBExecutor::run, this, work, now()));
+}
+
+DBExecutor::Stats DBExecutor::stats() const {
+  boost::mutex::scoped_lock lock(_mutex);
+  return _stats;
+}
+
+void DBExecutor::run(const Work& work, const boost::posix_time::ptime& queuedAt) {
+  const boost::uint64_t wait((now() - queuedAt).total_microseconds());
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    --_stats.queued;
+    ++_stats.busy;
+    if (wait > _stats.maxWait)
+      _stats.maxWait = wait;
+  }
+  // whatever the work throws is logged by the scheduler
+  try {
+    work();
+  } catch (...) {
+    finished(wait);
+    throw;
+  }
+  finished(wait);
+}
+
+// the wait is only added up once the work is counted as executed, so the two stay in step
+void DBExecutor::finished(const boost::uint64_t wait) {
+  boost::mutex::scoped_lock lock(_mutex);
+  --_stats.busy;
+  ++_stats.executed;
+  _stats.totalWait += wait;
+}
@@ -3,12 +3,22 @@
 
 EpisodesResourceHandler::EpisodesResourceHandler(const DBPtr db)
   : ResourceHandler(db,"episodes") { 
-  if (boost::dynamic_pointer_cast<SQLiteDB>(db)) {
+  const boost::shared_ptr<SQLiteDB> sqlite(boost::dynamic_pointer_cast<SQLiteDB>(db));
+  if (sqlite) {
     std::string errMsg;
     if (!db->execute("create table if not exists episodes (episode_id integer primary key asc autoincrement, episode_number integer not null, tvshow_id integer not null, season_id integer not null, episode_name text, episode_imdbid text, episode_imageurl text, foreign key(season_id) references seasons(season_id), foreign key(tvshow_id) references tvshows(tvshow_id), unique (episode_number,season_id,tvshow_id));",errMsg)) {
       std::cerr << "Unable to initialize episodes table in cache db. Reason: " << errMsg << std::endl;
       exit(1);
     }
+    std::vector<SQLiteDB::Index> indexes;
+    // covering, and ordered the way episodes are nested into seasons. numbers are
+    // looked up through the unique constraint's index
+    indexes.push_back(SQLiteDB::Index("episodes_by_tvshow","tvshow_id, season_id, episode_number, episode_name, episode_imdbid"));
+    indexes.push_back(SQLiteDB::Index("episodes_by_season","season_id, episode_number, episode_name, episode_imdbid, tvshow_id"));
+    if (!sqlite->ensureIndexes("episodes",indexes,errMsg)) {
+      std::cerr << "Unable to create indexes on episodes table in cache db. Reason: " << errMsg << std::endl;
+      exit(1);
+    }
   }
 }
 
@@ -25,18 +35,23 @@ SanitizedParams EpisodesResourceHandler::sanitizeQueryParams(const pion::net::HT
   const pion::net::HTTPTypes::QueryParams::const_iterator end(dirtyParams.end());
   for (; it!=end; ++it) {
     std::string sanitizedKey;
+    SanitizedParam::Type type(SanitizedParam::Text);
     const std::string& key = it->first;
-    if (key == id)
+    if (key == id) {
       sanitizedKey = episode_id;
-    else if (key == number)
+      type = SanitizedParam::Integer;
+    } else if (key == number) {
       sanitizedKey = episode_number;
-    else if (key == tvShow)
+      type = SanitizedParam::Integer;
+    } else if (key == tvShow) {
       sanitizedKey = tvshow_id;
-    else if (key == season)
+      type = SanitizedParam::Integer;
+    } else if (key == season) {
       sanitizedKey = season_id;
-    else
+      type = SanitizedParam::Integer;
+    } else
       continue;
-    sq.insert(std::make_pair(sanitizedKey,it->second));
+    sq.insert(std::make_pair(sanitizedKey,SanitizedParam(it->second,type)));
   }
   return sq;
 }
@@ -52,11 +67,10 @@ std::string EpisodesResourceHandler::listStatement() const {
 
 void EpisodesResourceHandler::initTestData() {
   if (boost::dynamic_pointer_cast<SQLiteDB>(db())) {
-    std::string errMsg;
-    db()->execute("insert into episodes(episode_id,episode_number,episode_name,tvshow_id,season_id) values (1,1,'Pilot',1,1);",errMsg);
-    db()->execute("insert into episodes(episode_id,episode_number,episode_name,tvshow_id,season_id) values (2,2,'The story begins!',1,1);",errMsg);
-    db()->execute("insert into episodes(episode_id,episode_number,episode_name,tvshow_id,season_id) values (3,1,'The story continues!',2,1);",errMsg);
-    db()->execute("insert into episodes(episode_id,episode_number,episode_name,tvshow_id,season_id) values (4,1,'Pilot!',3,2);",errMsg);
+    db()->queueWrite("insert into episodes(episode_id,episode_number,episode_name,tvshow_id,season_id) values (1,1,'Pilot',1,1);");
+    db()->queueWrite("insert into episodes(episode_id,episode_number,episode_name,tvshow_id,season_id) values (2,2,'The story begins!',1,1);");
+    db()->queueWrite("insert into episodes(episode_id,episode_number,episode_name,tvshow_id,season_id) values (3,1,'The story continues!',2,1);");
+    db()->queueWrite("insert into episodes(episode_id,episode_number,episode_name,tvshow_id,season_id) values (4,1,'Pilot!',3,2);");
   }
 }
 
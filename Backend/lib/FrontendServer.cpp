@@ -1,6 +1,6 @@
 #include "FrontendServer.h"
 #include "Options.h"
-#include "SQLiteDB.h"
+#include "CatalogDB.h"
 #include <pion/net/HTTPResponseWriter.hpp>
 #include <pion/net/HTTPTypes.hpp>
 #include <boost/bind.hpp>
@@ -9,20 +9,75 @@
 #include <iostream>
 #include <sstream>
 
+namespace {
+  pion::PionScheduler* createScheduler(const Options& o) {
+    pion::PionScheduler* scheduler;
+    if (o.scheduler == "shared")
+      scheduler = new pion::PionSingleServiceScheduler;
+    else
+      scheduler = new pion::PionOneToOneScheduler;
+    const unsigned int cores(boost::thread::hardware_concurrency());
+    scheduler->setNumThreads(o.threads ? o.threads : cores ? cores : 1);
+    return scheduler;
+  }
+
+  // resources that can't be kept in memory are still served by sqlite
+  void cacheInCatalog(const ResourceHandler& handler) {
+    std::string errMsg;
+    if (!handler.cacheInCatalog(errMsg))
+      std::cerr << "Unable to keep the rows of a resource in memory. Reason: " << errMsg << std::endl;
+  }
+}
+
 FrontendServer::FrontendServer(const Options& o)
-  : _httpServer(boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), o.port))
-  , _cacheDB(new SQLiteDB)
+  : _scheduler(createScheduler(o))
+  , _httpServer(*_scheduler, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), o.port))
+  , _cacheDB(new CatalogDB(o.writeBatchSize,o.writeBatchLatency))
   , _mh(_cacheDB)
   , _msh(_cacheDB)
   , _tvh(_cacheDB)
   , _sh(_cacheDB)
   , _eh(_cacheDB)
+  , _sth(_cacheDB)
 {
+  _mh.setChunkSize(o.chunkSize);
+  _msh.setChunkSize(o.chunkSize);
+  _tvh.setChunkSize(o.chunkSize);
+  _sh.setChunkSize(o.chunkSize);
+  _eh.setChunkSize(o.chunkSize);
+  _mh.setCompressionLevel(o.compressionLevel);
+  _msh.setCompressionLevel(o.compressionLevel);
+  _tvh.setCompressionLevel(o.compressionLevel);
+  _sh.setCompressionLevel(o.compressionLevel);
+  _eh.setCompressionLevel(o.compressionLevel);
+  if (o.responseCacheSize) {
+    const boost::shared_ptr<ResponseCache> responses(new ResponseCache(o.responseCacheSize));
+    _mh.setResponseCache(responses);
+    _msh.setResponseCache(responses);
+    _tvh.setResponseCache(responses);
+    _sh.setResponseCache(responses);
+    _eh.setResponseCache(responses);
+    _sth.setResponseCache(responses);
+  }
+  if (o.dbThreads) {
+    const boost::shared_ptr<DBExecutor> executor(new DBExecutor(o.dbThreads,o.dbQueueSize));
+    ResourceHandler* const handlers[] = { &_mh, &_msh, &_tvh, &_sh, &_eh, &_sth };
+    for (size_t i(0); i<sizeof(handlers)/sizeof(handlers[0]); ++i)
+      handlers[i]->setExecutor(executor);
+  }
   _mh.initTestData();
   _msh.initTestData();
   _tvh.initTestData();
   _sh.initTestData();
   _eh.initTestData();
+  _cacheDB->waitForQueuedWrites();
+  cacheInCatalog(_mh);
+  cacheInCatalog(_msh);
+  cacheInCatalog(_tvh);
+  cacheInCatalog(_sh);
+  cacheInCatalog(_eh);
+  // every thread accepts the connections it handles
+  _httpServer.setShardedFlag(o.scheduler == "sharded");
   _httpServer.setNotFoundHandler(
 				 boost::bind(&FrontendServer::handleNotFound, this, _1, _2));
   _httpServer.addResource(
@@ -40,6 +95,9 @@ FrontendServer::FrontendServer(const Options& o)
  _httpServer.addResource(
 			  "/episodes",
 			  boost::bind(&EpisodesResourceHandler::handle, &_eh, _1, _2));
+  _httpServer.addResource(
+			  "/status",
+			  boost::bind(&StatusResourceHandler::handle, &_sth, _1, _2));
 }
 
 void FrontendServer::run() {
@@ -48,6 +106,25 @@ void FrontendServer::run() {
   _httpServer.join();
 }
 
+namespace {
+  bool reportQueryPlans(const ResourceHandler& handler) {
+    std::string errMsg;
+    if (handler.checkQueryPlans(errMsg))
+      return true;
+    std::cerr << errMsg << std::endl;
+    return false;
+  }
+}
+
+bool FrontendServer::checkQueryPlans() const {
+  bool ok(reportQueryPlans(_mh));
+  ok = reportQueryPlans(_msh) && ok;
+  ok = reportQueryPlans(_tvh) && ok;
+  ok = reportQueryPlans(_sh) && ok;
+  ok = reportQueryPlans(_eh) && ok;
+  return ok;
+}
+
 namespace {
   void dumpRequestToCout(const pion::net::HTTPRequestPtr request) {
     std::cout << "Request: [method=\"" 
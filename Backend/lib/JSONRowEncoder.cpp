@@ -0,0 +1,148 @@
+#include "JSONRowEncoder.h"
+#include <json/writer.h>
+
+JSONRowEncoder::JSONRowEncoder(BufferPool& pool)
+  : RowEncoder(pool) {
+}
+
+void JSONRowEncoder::begin() {
+  append("{\"content\":[",12);
+  _items.assign(1,0);
+}
+
+void JSONRowEncoder::openRow(const ResultRow& row) {
+  assert(!_items.empty());
+  const int colCount(row.columnCount());
+  const size_t depth(_items.size()-1);
+  if (_keys.size() <= depth)
+    _keys.resize(depth+1);
+  std::vector<std::string>& keys(_keys[depth]);
+  if (keys.empty()) {
+    keys.reserve(colCount);
+    for (int i(0); i<colCount; ++i) {
+      const char* const name(row.columnName(i));
+      assert(name);
+      // column names are escaped once per query
+      std::string key(1,'"');
+      for (const char* c(name); *c; ++c) {
+	if (*c == '"' || *c == '\\')
+	  key += '\\';
+	key += *c;
+      }
+      key += "\":";
+      keys.push_back(key);
+    }
+  }
+  assert(static_cast<int>(keys.size()) == colCount);
+  append(_items.back() ? ",{" : "{", _items.back() ? 2 : 1);
+  ++_items.back();
+  for (int i(0); i<colCount; ++i) {
+    if (i)
+      append(',');
+    append(keys[i].data(),keys[i].size());
+    switch (row.columnType(i)) {
+    case ResultRow::Integer:
+      appendInteger(row.integerValue(i));
+      break;
+    case ResultRow::Float:
+      appendFloat(row.floatValue(i));
+      break;
+    case ResultRow::Text: {
+      const ResultRow::TextValue value(row.textValue(i));
+      appendString(value.data,value.size);
+      break;
+    }
+    default:
+      append("null",4);
+    }
+  }
+}
+
+void JSONRowEncoder::closeRow() {
+  append('}');
+}
+
+void JSONRowEncoder::openArray(const std::string& name) {
+  append(',');
+  appendString(name.data(),name.size());
+  append(":[",2);
+  _items.push_back(0);
+}
+
+void JSONRowEncoder::closeArray() {
+  assert(_items.size() > 1);
+  append(']');
+  _items.pop_back();
+}
+
+void JSONRowEncoder::end(const std::string* error) {
+  append("],\"error\":",10);
+  appendNullableString(error);
+  append('}');
+}
+
+void JSONRowEncoder::end(const std::string* error, const std::string* next) {
+  append("],\"next\":",9);
+  appendNullableString(next);
+  append(",\"error\":",9);
+  appendNullableString(error);
+  append('}');
+}
+
+void JSONRowEncoder::appendNullableString(const std::string* value) {
+  if (value)
+    appendString(value->data(),value->size());
+  else
+    append("null",4);
+}
+
+void JSONRowEncoder::appendString(const char* data, const size_t size) {
+  static const char hex[] = "0123456789abcdef";
+  append('"');
+  const char* run(data);
+  const char* const end(data+size);
+  for (const char* c(data); c!=end; ++c) {
+    const unsigned char uc(static_cast<unsigned char>(*c));
+    if (uc >= 0x20 && uc != '"' && uc != '\\')
+      continue;
+    // copy everything that didn't need escaping in one go
+    append(run,c-run);
+    run = c+1;
+    switch (uc) {
+    case '"': append("\\\"",2); break;
+    case '\\': append("\\\\",2); break;
+    case '\b': append("\\b",2); break;
+    case '\f': append("\\f",2); break;
+    case '\n': append("\\n",2); break;
+    case '\r': append("\\r",2); break;
+    case '\t': append("\\t",2); break;
+    default: {
+      const char escaped[6] = { '\\', 'u', '0', '0', hex[uc >> 4], hex[uc & 0xf] };
+      append(escaped,6);
+    }
+    }
+  }
+  append(run,end-run);
+  append('"');
+}
+
+void JSONRowEncoder::appendInteger(const boost::int64_t value) {
+  char digits[21];
+  char* const end(digits+sizeof(digits));
+  char* p(end);
+  // work on the magnitude as unsigned so the minimum value doesn't overflow
+  boost::uint64_t magnitude(value < 0 ? ~static_cast<boost::uint64_t>(value)+1 : static_cast<boost::uint64_t>(value));
+  do {
+    *--p = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude);
+  if (value < 0)
+    *--p = '-';
+  append(p,end-p);
+}
+
+// formatted like json::Writer does, so that a value reads back the same whichever wrote it
+void JSONRowEncoder::appendFloat(const double value) {
+  char formatted[json::Writer::NUMBER_DIGITS];
+  append(formatted,json::Writer::FormatNumber(value,formatted));
+}
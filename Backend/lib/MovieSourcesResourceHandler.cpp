@@ -3,12 +3,21 @@
 
 MovieSourcesResourceHandler::MovieSourcesResourceHandler(const DBPtr db)
   : ResourceHandler(db,"movieSources") {
-  if (boost::dynamic_pointer_cast<SQLiteDB>(db)) {
+  const boost::shared_ptr<SQLiteDB> sqlite(boost::dynamic_pointer_cast<SQLiteDB>(db));
+  if (sqlite) {
     std::string errMsg;
     if (!db->execute("create table if not exists moviesources (msrc_id integer primary key asc autoincrement, movie_id integer not null, msrc_url text, foreign key(movie_id) references movies(movie_id));", errMsg)) {
       std::cerr << "Unable to initialize movie_sources table in cache db. Reason: " << errMsg << std::endl;
       exit(1);
     }
+    std::vector<SQLiteDB::Index> indexes;
+    // covering, sources are looked up by movie
+    indexes.push_back(SQLiteDB::Index("moviesources_by_movie","movie_id, msrc_url"));
+    indexes.push_back(SQLiteDB::Index("moviesources_by_url","msrc_url"));
+    if (!sqlite->ensureIndexes("moviesources",indexes,errMsg)) {
+      std::cerr << "Unable to create indexes on movie_sources table in cache db. Reason: " << errMsg << std::endl;
+      exit(1);
+    }
   }
 }
 
@@ -24,16 +33,19 @@ SanitizedParams MovieSourcesResourceHandler::sanitizeQueryParams(const pion::net
   const pion::net::HTTPTypes::QueryParams::const_iterator end(dirtyParams.end());
   for (; it!=end; ++it) {
     std::string sanitizedKey;
+    SanitizedParam::Type type(SanitizedParam::Text);
     const std::string& key = it->first;
-    if (key == id)
+    if (key == id) {
       sanitizedKey = msrc_id;
-    else if (key == url)
+      type = SanitizedParam::Integer;
+    } else if (key == url)
       sanitizedKey = msrc_url;
-    else if (key == movie)
+    else if (key == movie) {
       sanitizedKey = movie_id;
-    else
+      type = SanitizedParam::Integer;
+    } else
       continue;
-    sq.insert(std::make_pair(sanitizedKey,it->second));
+    sq.insert(std::make_pair(sanitizedKey,SanitizedParam(it->second,type)));
   }
   return sq;
 }
@@ -49,8 +61,7 @@ std::string MovieSourcesResourceHandler::listStatement() const {
 
 void MovieSourcesResourceHandler::initTestData() {
   if (boost::dynamic_pointer_cast<SQLiteDB>(db())) {
-    std::string errMsg;
-    db()->execute("insert into moviesources(msrc_id,movie_id,msrc_url) values(1, 1, 'http://movies.apple.com/media/us/iphone/2010/ads/apple-iphone4-meet_her-us-20100711_r848-9cie.mov');",errMsg);
-    db()->execute("insert into moviesources(msrc_id,movie_id,msrc_url) values(2, 2, 'http://movies.apple.com/media/us/iphone/2010/ads/apple-iphone4-meet_her-us-20100711_r848-9cie.mov');",errMsg);
+    db()->queueWrite("insert into moviesources(msrc_id,movie_id,msrc_url) values(1, 1, 'http://movies.apple.com/media/us/iphone/2010/ads/apple-iphone4-meet_her-us-20100711_r848-9cie.mov');");
+    db()->queueWrite("insert into moviesources(msrc_id,movie_id,msrc_url) values(2, 2, 'http://movies.apple.com/media/us/iphone/2010/ads/apple-iphone4-meet_her-us-20100711_r848-9cie.mov');");
   }
 }
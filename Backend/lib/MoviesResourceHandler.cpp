@@ -3,12 +3,21 @@
 
 MoviesResourceHandler::MoviesResourceHandler(const DBPtr db)
   : ResourceHandler(db,"movies") {
-  if (boost::dynamic_pointer_cast<SQLiteDB>(db)) {
+  const boost::shared_ptr<SQLiteDB> sqlite(boost::dynamic_pointer_cast<SQLiteDB>(db));
+  if (sqlite) {
     std::string errMsg;
     if (!db->execute("create table if not exists movies (movie_id integer primary key asc autoincrement, movie_name text not null, movie_imdbid text, movie_coverurl text);", errMsg)) {
       std::cerr << "Unable to initialize movies table in cache db. Reason: " << errMsg << std::endl;
       exit(1);
     }
+    std::vector<SQLiteDB::Index> indexes;
+    indexes.push_back(SQLiteDB::Index("movies_by_name","movie_name"));
+    indexes.push_back(SQLiteDB::Index("movies_by_imdbid","movie_imdbid"));
+    indexes.push_back(SQLiteDB::Index("movies_by_coverurl","movie_coverurl"));
+    if (!sqlite->ensureIndexes("movies",indexes,errMsg)) {
+      std::cerr << "Unable to create indexes on movies table in cache db. Reason: " << errMsg << std::endl;
+      exit(1);
+    }
   }
 }
 
@@ -25,10 +34,12 @@ SanitizedParams MoviesResourceHandler::sanitizeQueryParams(const pion::net::HTTP
   const pion::net::HTTPTypes::QueryParams::const_iterator end(dirtyParams.end());
   for (; it!=end; ++it) {
     std::string sanitizedKey;
+    SanitizedParam::Type type(SanitizedParam::Text);
     const std::string& key = it->first;
-    if (key == id)
+    if (key == id) {
       sanitizedKey = movie_id;
-    else if (key == name)
+      type = SanitizedParam::Integer;
+    } else if (key == name)
       sanitizedKey = movie_name;
     else if (key == coverUrl)
       sanitizedKey = movie_coverurl;
@@ -36,7 +47,7 @@ SanitizedParams MoviesResourceHandler::sanitizeQueryParams(const pion::net::HTTP
       sanitizedKey = movie_imdbid;
     else
       continue;
-    sq.insert(std::make_pair(sanitizedKey,it->second));
+    sq.insert(std::make_pair(sanitizedKey,SanitizedParam(it->second,type)));
   }
   return sq;
 }
@@ -52,8 +63,7 @@ std::string MoviesResourceHandler::listStatement() const {
 
 void MoviesResourceHandler::initTestData() {
   if (boost::dynamic_pointer_cast<SQLiteDB>(db())) {
-    std::string errMsg;
-    db()->execute("insert into movies(movie_id,movie_name,movie_imdbid,movie_coverurl) values (1, 'Sex and the City', 'tt10000774', 'http://www.pursepage.com/wp-content/uploads/2008/01/sex-and-the-city-movie-poster.jpg');",errMsg);
-    db()->execute("insert into movies(movie_id,movie_name,movie_imdbid,movie_coverurl) values (2, 'Twilight', 'tt1099212', 'http://juiceboxdotcom.com/wp-content/themes/mimbo2.2/images//twilight-movie-poster.jpg');",errMsg);
+    db()->queueWrite("insert into movies(movie_id,movie_name,movie_imdbid,movie_coverurl) values (1, 'Sex and the City', 'tt10000774', 'http://www.pursepage.com/wp-content/uploads/2008/01/sex-and-the-city-movie-poster.jpg');");
+    db()->queueWrite("insert into movies(movie_id,movie_name,movie_imdbid,movie_coverurl) values (2, 'Twilight', 'tt1099212', 'http://juiceboxdotcom.com/wp-content/themes/mimbo2.2/images//twilight-movie-poster.jpg');");
   }
 }
@@ -1,28 +1,71 @@
 #include "ResourceHandler.h"
+#include "JSONRowEncoder.h"
+#include "CBORRowEncoder.h"
+#include "Compressor.h"
+#include "CatalogDB.h"
 #include <pion/net/HTTPTypes.hpp>
 #include <json/writer.h>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/tss.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <limits>
 #include <sstream>
 
 ResourceHandler::ResourceHandler(const DBPtr db, const std::string& source)
   : _db(db)
-  , _source(source) {}
+  , _source(source)
+  , _chunkSize(RESPONSE_CHUNK_SIZE)
+  , _compressionLevel(COMPRESSION_LEVEL) {}
 
 ResourceHandler::~ResourceHandler() {}
 
 void ResourceHandler::initTestData() {
 }
 
-void ResourceHandler::writeJsonHttpResponse(const json::Object& obj,pion::net::HTTPResponseWriter& writer,const bool setStatusOK) {
-      std::stringstream ss;
-      json::Writer::Write(obj,ss);
+namespace {
+  // every thread serializes into the same buffer over and over, so documents of the usual size
+  // don't allocate at all. one that grew the buffer past this size gives the memory back
+  const size_t maxKeptJsonBuffer(1024*1024);
+  boost::thread_specific_ptr<std::string> jsonBuffer;
+
+  const std::string formatVersionHeader("X-Format-Version");
+  const std::string jsonContentType("application/json");
+
+  // every response names the version of the document layout it's in, whatever its encoding
+  void setFormatHeaders(pion::net::HTTPResponse& response, const std::string& contentType) {
+    static const std::string version(boost::lexical_cast<std::string>(RowEncoder::FORMAT_VERSION));
+    response.setContentType(contentType);
+    response.addHeader(formatVersionHeader,version);
+  }
+}
+
+void ResourceHandler::writeJsonHttpResponse(const json::Object& obj,pion::net::HTTPResponseWriter& writer,const bool setStatusOK,const bool pretty) {
+      if (!jsonBuffer.get())
+	jsonBuffer.reset(new std::string());
+      std::string& buffer(*jsonBuffer);
+      buffer.clear();
+      json::Writer::Write(obj,buffer,pretty ? json::Writer::FORMAT_PRETTY : json::Writer::FORMAT_COMPACT);
       if (setStatusOK) {
 	writer.getResponse().setStatusCode(pion::net::HTTPTypes::RESPONSE_CODE_OK);
 	writer.getResponse().setStatusMessage(pion::net::HTTPTypes::RESPONSE_MESSAGE_OK);
       }
-      writer.write(ss.str().c_str());
+      setFormatHeaders(writer.getResponse(),jsonContentType);
+      writer.write(buffer.data(),buffer.size());
+      if (buffer.capacity() > maxKeptJsonBuffer)
+	std::string().swap(buffer);
       writer.send();
 }
 
+bool ResourceHandler::prettyJsonRequested(const pion::net::HTTPRequestPtr& request) {
+  return request->hasQuery("pretty");
+}
+
 DBPtr ResourceHandler::db() const {
   return _db;
 }
@@ -32,87 +75,1069 @@ void ResourceHandler::handle(pion::net::HTTPRequestPtr& request, pion::net::TCPC
     list(request,connection);
   else if (request->hasQuery("view"))
     view(request,connection);
-  else {
-    JSONObjectPtr doc(new json::Object);
-    (*doc)["error"] = json::String(std::string("unrecognized query ") + request->getQueryString());
-    boost::shared_ptr<pion::net::HTTPResponseWriter> writer(
-							    pion::net::HTTPResponseWriter::create(
-												  connection,
-												  *request,
-												  boost::bind(&pion::net::TCPConnection::finish, connection)));
-    writer->getResponse().setStatusCode(pion::net::HTTPTypes::RESPONSE_CODE_NOT_IMPLEMENTED);
-    writer->getResponse().setStatusMessage(pion::net::HTTPTypes::RESPONSE_MESSAGE_NOT_IMPLEMENTED);
-    writeJsonHttpResponse(
-			  *doc,
-			  *writer,
-			  false);
-  }
+  else
+    writeJsonErrorResponse(
+			   request,
+			   connection,
+			   pion::net::HTTPTypes::RESPONSE_CODE_NOT_IMPLEMENTED,
+			   pion::net::HTTPTypes::RESPONSE_MESSAGE_NOT_IMPLEMENTED,
+			   std::string("unrecognized query ") + request->getQueryString());
+}
+
+void ResourceHandler::writeJsonErrorResponse(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection, const unsigned int statusCode, const std::string& statusMessage, const std::string& errorMessage) {
+  JSONObjectPtr doc(new json::Object);
+  (*doc)["error"] = json::String(errorMessage);
+  boost::shared_ptr<pion::net::HTTPResponseWriter> writer(
+							  pion::net::HTTPResponseWriter::create(
+												connection,
+												*request,
+												boost::bind(&pion::net::TCPConnection::finish, connection)));
+  writer->getResponse().setStatusCode(statusCode);
+  writer->getResponse().setStatusMessage(statusMessage);
+  writeJsonHttpResponse(
+			*doc,
+			*writer,
+			false,
+			prettyJsonRequested(request));
 }
 
 
 namespace {
-  struct Lister {
-    Lister() : _doc(new json::Object) {}
+  BufferPool& responseBuffers() {
+    static BufferPool pool;
+    return pool;
+  }
+
+  // keeps the encoded response alive until the writer is done sending it
+  void finishResponse(const pion::net::TCPConnectionPtr& connection, const boost::shared_ptr<RowEncoder>&, const ResponseCache::Body&) {
+    connection->finish();
+  }
+
+  void finishCachedResponse(const pion::net::TCPConnectionPtr& connection, const ResponseCache::Body&) {
+    connection->finish();
+  }
+
+  const std::string etagHeader("ETag");
+  const std::string ifNoneMatchHeader("If-None-Match");
+  const std::string idKey("id");
+  const std::string limitParam("limit");
+  const std::string orderParam("order");
+  const std::string afterParam("after");
+  const std::string expandParam("expand");
+  const std::string acceptHeader("Accept");
+  const std::string acceptEncodingHeader("Accept-Encoding");
+  const std::string contentEncodingHeader("Content-Encoding");
+  const std::string varyHeader("Vary");
+  const std::string negotiatedHeaders("Accept, Accept-Encoding");
+  const std::string cborContentType("application/cbor");
+  const unsigned int serviceUnavailableCode(503);
+  const std::string serviceUnavailableMessage("Service Unavailable");
+
+  // the encodings results can be sent in
+  enum ResultFormat { FORMAT_JSON, FORMAT_CBOR };
+
+  std::string trimmed(const std::string& s) {
+    const std::string::size_type first(s.find_first_not_of(" \t"));
+    const std::string::size_type last(s.find_last_not_of(" \t"));
+    return first == std::string::npos ? std::string() : s.substr(first,last-first+1);
+  }
+
+  // the values of a header like Accept or Accept-Encoding, lowercased, with their qualities
+  typedef std::vector<std::pair<std::string,double> > Qualities;
+  Qualities qualities(const std::string& header) {
+    Qualities values;
+    std::string::size_type begin(0);
+    while (begin < header.size()) {
+      std::string::size_type end(header.find(',',begin));
+      if (end == std::string::npos)
+	end = header.size();
+      const std::string item(header.substr(begin,end-begin));
+      begin = end+1;
+      const std::string::size_type semicolon(item.find(';'));
+      std::string value(trimmed(item.substr(0,semicolon)));
+      if (value.empty())
+	continue;
+      std::transform(value.begin(),value.end(),value.begin(),::tolower);
+      double quality(1);
+      std::string::size_type param(semicolon);
+      while (param != std::string::npos) {
+	const std::string::size_type next(item.find(';',param+1));
+	const std::string p(trimmed(item.substr(param+1,next == std::string::npos ? std::string::npos : next-param-1)));
+	if (p.size() > 2 && (p[0] == 'q' || p[0] == 'Q') && p[1] == '=')
+	  quality = strtod(p.c_str()+2,0);
+	param = next;
+      }
+      values.push_back(std::make_pair(value,quality));
+    }
+    return values;
+  }
+
+  // the quality an Accept header gives a media type, which is that of the most specific range
+  // matching it. named tells whether the type itself is listed rather than matched by a wildcard
+  double acceptQuality(const std::string& accept, const std::string& type, bool& named) {
+    named = false;
+    const Qualities ranges(qualities(accept));
+    if (ranges.empty())
+      return 1;
+    const std::string anySubtype(type.substr(0,type.find('/')) + "/*");
+    double quality(0);
+    int specificity(0);
+    Qualities::const_iterator it(ranges.begin());
+    for (; it!=ranges.end(); ++it) {
+      const int matched(it->first == type ? 3 : it->first == anySubtype ? 2 : it->first == "*/*" ? 1 : 0);
+      if (matched > specificity) {
+	specificity = matched;
+	quality = it->second;
+      }
+    }
+    named = specificity == 3;
+    return quality;
+  }
+
+  // results are sent as CBOR if the client prefers it to json, or names it while json is only
+  // covered by a wildcard. an Accept header that allows neither still gets json rather than an error
+  ResultFormat resultFormat(const pion::net::HTTPRequest& request) {
+    const std::string& accept(request.getHeader(acceptHeader));
+    bool jsonNamed(false), cborNamed(false);
+    const double json(acceptQuality(accept,jsonContentType,jsonNamed));
+    const double cbor(acceptQuality(accept,cborContentType,cborNamed));
+    if (cbor > 0 && (cbor > json || (cbor == json && cborNamed && !jsonNamed)))
+      return FORMAT_CBOR;
+    return FORMAT_JSON;
+  }
+
+  // the content coding a response is compressed with, or an empty one if it isn't. gzip is used
+  // unless the client prefers deflate, and without an Accept-Encoding header nothing is compressed
+  std::string contentCoding(const pion::net::HTTPRequest& request) {
+    const Qualities codings(qualities(request.getHeader(acceptEncodingHeader)));
+    double gzip(-1), deflate(-1), any(0);
+    Qualities::const_iterator it(codings.begin());
+    for (; it!=codings.end(); ++it) {
+      if (it->first == Compressor::GZIP || it->first == "x-gzip")
+	gzip = it->second;
+      else if (it->first == Compressor::DEFLATE)
+	deflate = it->second;
+      else if (it->first == "*")
+	any = it->second;
+    }
+    // codings that aren't named get the quality of the wildcard
+    if (gzip < 0)
+      gzip = any;
+    if (deflate < 0)
+      deflate = any;
+    if (gzip > 0 && gzip >= deflate)
+      return Compressor::GZIP;
+    if (deflate > 0)
+      return Compressor::DEFLATE;
+    return std::string();
+  }
+
+  ResponseCache::Body compressedBody(const RowEncoder::Buffers& buffers, const std::string& coding, const int level) {
+    Compressor compressor(coding,level);
+    std::string* const body(new std::string);
+    const ResponseCache::Body compressed(body);
+    RowEncoder::Buffers::const_iterator it(buffers.begin());
+    for (; it!=buffers.end(); ++it)
+      compressor.write((*it)->data(),(*it)->size(),*body);
+    compressor.flush(*body,true);
+    return compressed;
+  }
+
+  ResponseCache::Body compressedBody(const std::string& plain, const std::string& coding, const int level) {
+    Compressor compressor(coding,level);
+    std::string* const body(new std::string);
+    const ResponseCache::Body compressed(body);
+    compressor.write(plain.data(),plain.size(),*body);
+    compressor.flush(*body,true);
+    return compressed;
+  }
+
+  const std::string& contentType(const ResultFormat format) {
+    return format == FORMAT_CBOR ? cborContentType : jsonContentType;
+  }
+
+  boost::shared_ptr<RowEncoder> createEncoder(const ResultFormat format) {
+    if (format == FORMAT_CBOR)
+      return boost::shared_ptr<RowEncoder>(new CBORRowEncoder(responseBuffers()));
+    return boost::shared_ptr<RowEncoder>(new JSONRowEncoder(responseBuffers()));
+  }
+
+  // everything the response to a query is made from, handed over from the I/O thread that parsed
+  // the request to the thread running the query
+  struct ResultsJob {
+    ResultsJob(const pion::net::HTTPRequestPtr& request, const pion::net::TCPConnectionPtr& connection, const DBPtr& db, const ResultFormat format, const std::string& coding, const int compressionLevel, const size_t chunkSize, const boost::shared_ptr<ResponseCache>& cache, const boost::shared_ptr<DBExecutor>& executor)
+      : request(request), connection(connection), db(db), format(format), coding(coding), compressionLevel(compressionLevel), chunkSize(chunkSize), cache(cache), generation(0), executor(executor) {}
+    const pion::net::HTTPRequestPtr request;
+    const pion::net::TCPConnectionPtr connection;
+    const DBPtr db;
+    const ResultFormat format;
+    const std::string coding;
+    const int compressionLevel;
+    const size_t chunkSize;
+    const boost::shared_ptr<ResponseCache> cache;
+    std::string key;
+    std::string etag;
+    boost::uint64_t generation;
+    const boost::shared_ptr<DBExecutor> executor; // null if the query runs on the I/O thread
+  };
+  typedef boost::shared_ptr<ResultsJob> ResultsJobPtr;
+
+  // continues a response on the I/O thread of its connection once the db work for it is done, so
+  // that the executor's threads never touch a socket
+  void resume(const pion::net::TCPConnectionPtr& connection, const boost::shared_ptr<DBExecutor>& executor, const boost::function<void ()>& handler) {
+    if (executor)
+      connection->getIOService().post(handler);
+    else
+      handler();
+  }
+
+  void sendResponse(const pion::net::HTTPResponseWriterPtr& writer) {
+    writer->send();
+  }
+
+  std::string columnText(const ResultRow& row, const int column) {
+    switch (row.columnType(column)) {
+    case ResultRow::Integer: {
+      std::ostringstream ss;
+      ss << row.integerValue(column);
+      return ss.str();
+    }
+    case ResultRow::Float: {
+      std::ostringstream ss;
+      ss.precision(17);
+      ss << row.floatValue(column);
+      return ss.str();
+    }
+    case ResultRow::Text: {
+      const ResultRow::TextValue value(row.textValue(column));
+      return std::string(value.data,value.size);
+    }
+    default:
+      return std::string();
+    }
+  }
 
-    void callback(int colCount, char** colValues, char** colNames) {
-      json::Object item;
+  // stops a cursor after a page worth of rows. the query is run with a limit one row larger
+  // than the page, so whether that row exists tells if there is a next page. its cursor is
+  // <id> or <id>:<order value> made from the last row of the page, with the order value
+  // left out when it is null or the page is ordered by id anyway
+  class PageCursor : public Cursor {
+  public:
+    PageCursor(const CursorPtr& cursor, const size_t limit, const std::string& orderKey)
+      : _cursor(cursor), _limit(limit), _orderKey(orderKey), _rows(0), _peeked(false), _more(false) {}
+
+    virtual bool next() {
+      if (_limit && _rows == _limit) {
+	if (!_peeked) {
+	  _more = _cursor->next();
+	  _peeked = true;
+	}
+	return false;
+      }
+      if (!_cursor->next())
+	return false;
+      if (++_rows == _limit)
+	rememberLastRow(_cursor->row());
+      return true;
+    }
+
+    virtual const ResultRow& row() const {
+      return _cursor->row();
+    }
+
+    virtual bool failed(std::string& errorMessage) const {
+      return _cursor->failed(errorMessage);
+    }
+
+    const std::string* nextPage() const {
+      return _more ? &_next : 0;
+    }
+
+  private:
+    void rememberLastRow(const ResultRow& row) {
+      const int colCount(row.columnCount());
+      int idColumn(-1), orderColumn(-1);
       for (int i(0); i<colCount; ++i) {
-	assert(colNames[i]);
-	if ( const char* const value = colValues[i] )
-	  item[colNames[i]] = json::String(value);
+	const char* const name(row.columnName(i));
+	if (idKey == name)
+	  idColumn = i;
+	if (_orderKey == name)
+	  orderColumn = i;
+      }
+      assert(idColumn >= 0);
+      _next = columnText(row,idColumn);
+      if (orderColumn >= 0 && orderColumn != idColumn && row.columnType(orderColumn) != ResultRow::Null)
+	_next += ':' + columnText(row,orderColumn);
+    }
+
+    const CursorPtr _cursor;
+    const size_t _limit;
+    const std::string _orderKey;
+    size_t _rows;
+    bool _peeked;
+    bool _more;
+    std::string _next;
+  };
+
+  // integer values have to be plain integers. sqlite would also match the likes of 1.0 or 1e0
+  // against an integer column, while the catalog compares integers as such, so those are turned
+  // away before either gets to see them
+  bool integerParam(const SanitizedParam& param) {
+    boost::int64_t value;
+    return param.type != SanitizedParam::Integer || param.integerValue(value);
+  }
+
+  // splits comma separated lists of integer values into one param per value, text values are
+  // left alone since they may contain commas themselves. fails if a key has too many values or
+  // an integer value isn't one
+  bool expandValueLists(SanitizedParams& sq, std::string& errorMessage) {
+    SanitizedParams expanded;
+    SanitizedParams::const_iterator it(sq.begin());
+    const SanitizedParams::const_iterator end(sq.end());
+    for (; it!=end; ++it) {
+      const std::string& value(it->second.value);
+      if (it->second.type != SanitizedParam::Integer || value.find(',') == std::string::npos) {
+	expanded.insert(*it);
+	continue;
+      }
+      std::string::size_type begin(0);
+      while (true) {
+	const std::string::size_type comma(value.find(',',begin));
+	expanded.insert(std::make_pair(it->first,SanitizedParam(value.substr(begin,comma-begin),SanitizedParam::Integer)));
+	if (comma == std::string::npos)
+	  break;
+	begin = comma+1;
+      }
+    }
+    // an empty value is let through and simply matches nothing
+    for (it = expanded.begin(); it!=expanded.end(); ++it) {
+      if (!it->second.value.empty() && !integerParam(it->second)) {
+	errorMessage = "malformed integer " + it->second.value;
+	return false;
+      }
+    }
+    for (it = expanded.begin(); it!=expanded.end(); it = expanded.upper_bound(it->first)) {
+      if (expanded.count(it->first) > MAX_MULTI_GET_SIZE) {
+	std::ostringstream ss;
+	ss << "no more than " << MAX_MULTI_GET_SIZE << " values can be looked up at once";
+	errorMessage = ss.str();
+	return false;
+      }
+    }
+    sq.swap(expanded);
+    return true;
+  }
+
+  // the rows of a response, encoded a chunk at a time
+  class ResultSource {
+  public:
+    virtual ~ResultSource() {}
+    // encodes rows until the encoder holds at least limit bytes. returns true once all rows are encoded
+    virtual bool encode(RowEncoder& encoder, const size_t limit) = 0;
+    virtual bool failed(std::string& errorMessage) const = 0;
+    virtual void end(RowEncoder& encoder, const std::string* error) const {
+      encoder.end(error);
+    }
+  };
+  typedef boost::shared_ptr<ResultSource> ResultSourcePtr;
+
+  class CursorResults : public ResultSource {
+  public:
+    CursorResults(const CursorPtr& cursor, const boost::shared_ptr<PageCursor>& page)
+      : _cursor(cursor), _page(page) {}
+
+    virtual bool encode(RowEncoder& encoder, const size_t limit) {
+      while (encoder.size() < limit) {
+	if (!_cursor->next())
+	  return true;
+	encoder.row(_cursor->row());
+      }
+      return false;
+    }
+
+    virtual bool failed(std::string& errorMessage) const {
+      return _cursor->failed(errorMessage);
+    }
+
+    virtual void end(RowEncoder& encoder, const std::string* error) const {
+      if (_page)
+	encoder.end(error,_page->nextPage());
+      else
+	encoder.end(error);
+    }
+
+  private:
+    const CursorPtr _cursor;
+    const boost::shared_ptr<PageCursor> _page; // null unless the results are paged
+  };
+
+  int columnIndex(const ResultRow& row, const std::string& name) {
+    const int colCount(row.columnCount());
+    for (int i(0); i<colCount; ++i) {
+      if (name == row.columnName(i))
+	return i;
+    }
+    assert(false);
+    return -1;
+  }
+
+  // merges the cursors of an expansion into nested rows. every level is ordered the same way as
+  // the one above it, so the children of a row are the rows that come up next on the level below
+  // and a single pass over each cursor produces the whole tree
+  class ExpandedResults : public ResultSource {
+  public:
+    ExpandedResults(const std::vector<CursorPtr>& cursors, const std::vector<ResourceHandler::Expansion>& levels)
+      : _cursors(cursors), _levels(levels), _idColumns(levels.size(),-1), _parentColumns(levels.size(),-1), _pending(levels.size(),false), _done(levels.size(),false) {
+      assert(_cursors.size() == _levels.size());
+    }
+
+    virtual bool encode(RowEncoder& encoder, const size_t limit) {
+      while (encoder.size() < limit) {
+	const size_t depth(_open.size());
+	if (depth == 0) {
+	  if (!_cursors[0]->next())
+	    return true;
+	  openRow(encoder,0);
+	} else if (depth < _levels.size() && nextChild(depth))
+	  openRow(encoder,depth);
 	else
-	  item[colNames[i]] = json::Null();
+	  closeRow(encoder);
+      }
+      return false;
+    }
+
+    virtual bool failed(std::string& errorMessage) const {
+      std::vector<CursorPtr>::const_iterator it(_cursors.begin());
+      for (; it!=_cursors.end(); ++it) {
+	if ((*it)->failed(errorMessage))
+	  return true;
       }
-      _content.Insert(item);
+      return false;
     }
 
-    void finish() {
-      (*_doc)["content"] = _content;
-      (*_doc)["error"] = json::Null();
+  private:
+    // whether the next row of the level belongs to the row open on the level above
+    bool nextChild(const size_t level) {
+      if (!_pending[level]) {
+	if (_done[level] || !_cursors[level]->next()) {
+	  _done[level] = true;
+	  return false;
+	}
+	_pending[level] = true;
+      }
+      const ResultRow& row(_cursors[level]->row());
+      if (_parentColumns[level] < 0)
+	_parentColumns[level] = columnIndex(row,_levels[level].parentKey);
+      return row.integerValue(_parentColumns[level]) == _open.back();
     }
 
-    JSONObjectPtr _doc;
-    json::Array _content;
+    void openRow(RowEncoder& encoder, const size_t level) {
+      const ResultRow& row(_cursors[level]->row());
+      if (_idColumns[level] < 0)
+	_idColumns[level] = columnIndex(row,idKey);
+      encoder.openRow(row);
+      _open.push_back(row.integerValue(_idColumns[level]));
+      _pending[level] = false;
+      if (level+1 < _levels.size())
+	encoder.openArray(_levels[level+1].member);
+    }
+
+    void closeRow(RowEncoder& encoder) {
+      if (_open.size() < _levels.size())
+	encoder.closeArray();
+      encoder.closeRow();
+      _open.pop_back();
+    }
+
+    const std::vector<CursorPtr> _cursors;
+    const std::vector<ResourceHandler::Expansion> _levels;
+    std::vector<int> _idColumns;
+    std::vector<int> _parentColumns;
+    std::vector<bool> _pending; // the cursor is on a row that hasn't been encoded yet
+    std::vector<bool> _done;
+    std::vector<boost::int64_t> _open; // ids of the rows currently open on each level
+  };
+
+  void writeBuffers(pion::net::HTTPResponseWriter& writer, const RowEncoder::Buffers& buffers) {
+    RowEncoder::Buffers::const_iterator it(buffers.begin());
+    const RowEncoder::Buffers::const_iterator end(buffers.end());
+    for (; it!=end; ++it)
+      writer.writeNoCopy((*it)->data(),(*it)->size());
+  }
+
+  // sends the rows of a cursor as a chunked response. the next chunk is only encoded once the
+  // previous one has been written to the socket, so a slow client leaves the cursor paused
+  // instead of piling the response up in memory. with a compressor, every chunk is compressed
+  // as it goes out. with an executor, chunks are encoded there and sent from the I/O thread
+  class ChunkedResults : public boost::enable_shared_from_this<ChunkedResults> {
+  public:
+    ChunkedResults(const ResultSourcePtr& source, const boost::shared_ptr<RowEncoder>& encoder, const pion::net::HTTPResponseWriterPtr& writer, const size_t chunkSize, const boost::shared_ptr<Compressor>& compressor, const boost::shared_ptr<DBExecutor>& executor)
+      : _source(source), _encoder(encoder), _writer(writer), _chunkSize(chunkSize), _compressor(compressor), _executor(executor), _last(false) {}
+
+    // hands what the encoder holds to the writer as the next chunk
+    void prepareChunk(const bool last) {
+      _last = last;
+      _encoder->takeBuffers(_inFlight);
+      if (_compressor) {
+	_compressed.clear();
+	RowEncoder::Buffers::const_iterator it(_inFlight.begin());
+	for (; it!=_inFlight.end(); ++it)
+	  _compressor->write((*it)->data(),(*it)->size(),_compressed);
+	// flushing every chunk lets the client decompress it right away
+	_compressor->flush(_compressed,last);
+	_inFlight.clear();
+	_writer->writeNoCopy(_compressed);
+      } else
+	writeBuffers(*_writer,_inFlight);
+    }
+
+    void sendChunk() {
+      try {
+	if (_last)
+	  _writer->sendFinalChunk(boost::bind(&ChunkedResults::handleLastChunk,shared_from_this(),_1));
+	else
+	  _writer->sendChunk(boost::bind(&ChunkedResults::handleChunk,shared_from_this(),_1));
+      } catch (const pion::net::HTTPWriter::LostConnectionException&) {
+	_writer->getTCPConnection()->finish();
+      }
+    }
+
+  private:
+    void handleChunk(const boost::system::error_code& error) {
+      _inFlight.clear();
+      _writer->clear();
+      if (error) {
+	_writer->getTCPConnection()->setLifecycle(pion::net::TCPConnection::LIFECYCLE_CLOSE);
+	_writer->getTCPConnection()->finish();
+	return;
+      }
+      // a response under way is never turned away, however long the executor's queue is
+      if (_executor)
+	_executor->submit(boost::bind(&ChunkedResults::encodeChunk,shared_from_this()));
+      else
+	encodeChunk();
+    }
+
+    void encodeChunk() {
+      const bool last(_source->encode(*_encoder,_chunkSize));
+      if (last) {
+	// the status line is long gone, so a failure can only be reported in the document
+	std::string errMsg;
+	_source->end(*_encoder,_source->failed(errMsg) ? &errMsg : 0);
+      }
+      prepareChunk(last);
+      resume(_writer->getTCPConnection(),_executor,boost::bind(&ChunkedResults::sendChunk,shared_from_this()));
+    }
+
+    void handleLastChunk(const boost::system::error_code& error) {
+      if (error)
+	_writer->getTCPConnection()->setLifecycle(pion::net::TCPConnection::LIFECYCLE_CLOSE);
+      _writer->getTCPConnection()->finish();
+    }
+
+    const ResultSourcePtr _source;
+    const boost::shared_ptr<RowEncoder> _encoder;
+    const pion::net::HTTPResponseWriterPtr _writer;
+    const size_t _chunkSize;
+    const boost::shared_ptr<Compressor> _compressor; // null unless the response is compressed
+    const boost::shared_ptr<DBExecutor> _executor; // null if chunks are encoded on the I/O thread
+    bool _last;
+    RowEncoder::Buffers _inFlight;
+    std::string _compressed; // the compressed chunk in flight
   };
 
+  // the key a response is cached under. the values of a multi-valued param are sorted, since the
+  // order they're given in doesn't change the response. every format is cached on its own
+  std::string responseKey(const ResultFormat format, const std::string& source, const std::vector<std::string>& statements, const SanitizedParams& sq, const PageParams& page, const std::string& orderKey) {
+    std::ostringstream key;
+    key << source << '\0' << format;
+    std::vector<std::string>::const_iterator stmt(statements.begin());
+    for (; stmt!=statements.end(); ++stmt)
+      key << '\0' << *stmt;
+    SanitizedParams::const_iterator it(sq.begin());
+    while (it!=sq.end()) {
+      const SanitizedParams::const_iterator next(sq.upper_bound(it->first));
+      key << '\0' << it->first;
+      std::vector<std::string> values;
+      for (; it!=next; ++it)
+	values.push_back(it->second.value);
+      std::sort(values.begin(),values.end());
+      values.erase(std::unique(values.begin(),values.end()),values.end());
+      key << '\0' << values.size();
+      std::vector<std::string>::const_iterator value(values.begin());
+      for (; value!=values.end(); ++value)
+	key << '\0' << *value;
+    }
+    if (!page.empty()) {
+      key << '\0' << page.orderColumn << '\0' << orderKey << '\0' << page.descending << '\0' << page.limit;
+      if (page.hasAfter)
+	key << '\0' << page.afterKey.value << '\0' << page.afterOrderIsNull << '\0' << page.afterOrder.value;
+    }
+    return key.str();
+  }
+
+  // strong etags name the data a response was made from by the generation of its tables. those
+  // start over whenever the server does, so the etags also carry the time it was started, and a
+  // hash of the response's key so that no two responses share one
+  std::string responseETag(const std::string& key, const boost::uint64_t generation) {
+    static const time_t started(time(0));
+    std::ostringstream etag;
+    etag << '"' << std::hex << started << '-' << generation << '-' << boost::hash<std::string>()(key) << '"';
+    return etag.str();
+  }
+
+  // a compressed response differs from the uncompressed one byte for byte, so it has an etag of its own
+  std::string codedETag(const std::string& etag, const std::string& coding) {
+    assert(etag.size() > 1 && etag[etag.size()-1] == '"');
+    return etag.substr(0,etag.size()-1) + '-' + coding + '"';
+  }
+
+  // whether an If-None-Match header lists the etag, or is a wildcard. weak etags compare equal to
+  // strong ones here, as they do for If-None-Match
+  bool etagListed(const std::string& ifNoneMatch, const std::string& etag) {
+    std::string::size_type begin(0);
+    while (begin < ifNoneMatch.size()) {
+      std::string::size_type end(ifNoneMatch.find(',',begin));
+      if (end == std::string::npos)
+	end = ifNoneMatch.size();
+      std::string candidate(trimmed(ifNoneMatch.substr(begin,end-begin)));
+      if (candidate.compare(0,2,"W/") == 0)
+	candidate.erase(0,2);
+      if (candidate == "*" || candidate == etag)
+	return true;
+      begin = end+1;
+    }
+    return false;
+  }
+
+  // sends the rows of a source, or a failed source's error, in the format the client asked for and
+  // compressed with the job's coding unless that is empty or the response is too small to bother.
+  // a successful response carries the etag if there is one, and is put into the cache along with
+  // its compressed variant if there is one and it went out in one piece. the rows are encoded on
+  // the calling thread, the response is sent from the connection's
+  void writeResults(const ResultsJob& job, const ResultSourcePtr& source, std::string errMsg) {
+    const ResultFormat format(job.format);
+    const std::string& coding(job.coding);
+    const std::string& etag(job.etag);
+    const size_t chunkSize(job.chunkSize);
+    pion::net::TCPConnectionPtr connection(job.connection);
+    const boost::shared_ptr<RowEncoder> encoder(createEncoder(format));
+    encoder->begin();
+    // results that fit into a single chunk go out in one piece with a content length
+    const bool complete(!source || source->encode(*encoder,chunkSize ? chunkSize : std::numeric_limits<size_t>::max()));
+    const bool ok(source && !(complete && source->failed(errMsg)));
+    if (!ok) {
+      // whatever made it out before the failure is dropped, only the error is reported
+      encoder->clear();
+      encoder->begin();
+    }
+    if (complete) {
+      if (source)
+	source->end(*encoder,ok ? 0 : &errMsg);
+      else
+	encoder->end(&errMsg);
+    }
+    const bool compress(!coding.empty() && (!complete || encoder->size() >= MIN_COMPRESSED_SIZE));
+    const ResponseCache::Body compressed(compress && complete ? compressedBody(encoder->buffers(),coding,job.compressionLevel) : ResponseCache::Body());
+    const pion::net::HTTPResponseWriterPtr writer(
+						pion::net::HTTPResponseWriter::create(
+										      connection,
+										      *job.request,
+										      boost::bind(&finishResponse, connection, encoder, compressed)));
+    if (ok) {
+      writer->getResponse().setStatusCode(pion::net::HTTPTypes::RESPONSE_CODE_OK);
+      writer->getResponse().setStatusMessage(pion::net::HTTPTypes::RESPONSE_MESSAGE_OK);
+      if (!etag.empty())
+	writer->getResponse().addHeader(etagHeader,compress ? codedETag(etag,coding) : etag);
+    } else {
+      writer->getResponse().setStatusCode(pion::net::HTTPTypes::RESPONSE_CODE_SERVER_ERROR);
+      writer->getResponse().setStatusMessage(pion::net::HTTPTypes::RESPONSE_MESSAGE_SERVER_ERROR);
+    }
+    setFormatHeaders(writer->getResponse(),contentType(format));
+    writer->getResponse().addHeader(varyHeader,negotiatedHeaders);
+    if (compress)
+      writer->getResponse().addHeader(contentEncodingHeader,coding);
+    if (complete) {
+      if (ok && job.cache && !etag.empty()) {
+	std::string* const body(new std::string);
+	const ResponseCache::Body plain(body);
+	body->reserve(encoder->size());
+	RowEncoder::Buffers::const_iterator it(encoder->buffers().begin());
+	for (; it!=encoder->buffers().end(); ++it)
+	  body->append((*it)->data(),(*it)->size());
+	job.cache->insert(job.key,job.generation,plain);
+	if (compressed)
+	  job.cache->insertVariant(job.key,job.generation,coding,compressed);
+      }
+      if (compressed)
+	writer->writeNoCopy(*compressed);
+      else
+	writeBuffers(*writer,encoder->buffers());
+      resume(job.connection,job.executor,boost::bind(&sendResponse,writer));
+    } else {
+      const boost::shared_ptr<Compressor> compressor(compress ? new Compressor(coding,job.compressionLevel) : 0);
+      const boost::shared_ptr<ChunkedResults> chunked(new ChunkedResults(source,encoder,writer,chunkSize,compressor,job.executor));
+      chunked->prepareChunk(false);
+      resume(job.connection,job.executor,boost::bind(&ChunkedResults::sendChunk,chunked));
+    }
+  }
+
+  // the db part of a response to a query, run on the executor if there is one
+  void queryResults(const ResultsJobPtr& job, const std::string& stmt, const SanitizedParams& sq, const PageParams& page, const std::string& orderKey) {
+    std::string errMsg;
+    ResultSourcePtr source;
+    if (page.empty()) {
+      const CursorPtr cursor(job->db->openCursor(stmt,errMsg,sq));
+      if (cursor)
+	source.reset(new CursorResults(cursor,boost::shared_ptr<PageCursor>()));
+    } else {
+      // one row past the page is fetched to find out whether there is another page
+      PageParams lookahead(page);
+      if (lookahead.limit)
+	++lookahead.limit;
+      const CursorPtr rows(job->db->openCursor(stmt,errMsg,sq,lookahead));
+      if (rows) {
+	const boost::shared_ptr<PageCursor> paged(new PageCursor(rows,page.limit,orderKey));
+	source.reset(new CursorResults(paged,paged));
+      }
+    }
+    writeResults(*job,source,errMsg);
+  }
+
+  // every level is a single query, the nesting is done while streaming the rows
+  void expandedResults(const ResultsJobPtr& job, const std::vector<ResourceHandler::Expansion>& levels, const SanitizedParams& sq) {
+    std::string errMsg;
+    std::vector<CursorPtr> cursors;
+    std::vector<ResourceHandler::Expansion>::const_iterator it(levels.begin());
+    for (; it!=levels.end(); ++it) {
+      const CursorPtr cursor(job->db->openCursor(it->statement,errMsg,sq,it->order));
+      if (!cursor)
+	break;
+      cursors.push_back(cursor);
+    }
+    ResultSourcePtr source;
+    if (cursors.size() == levels.size())
+      source.reset(new ExpandedResults(cursors,levels));
+    writeResults(*job,source,errMsg);
+  }
 }
 
-void ResourceHandler::list(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection) {
-    Lister l;
+void ResourceHandler::writeQueryResults(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection, const std::string& stmt, const SanitizedParams& sq, const PageParams& page, const std::string& orderKey) {
+  assert(!stmt.empty());
+  assert(_db);
+  const std::vector<std::string> statements(1,stmt);
+  const ResultsJobPtr job(new ResultsJob(request,connection,_db,resultFormat(*request),_compressionLevel ? contentCoding(*request) : std::string(),_compressionLevel,_chunkSize,_responses,_executor));
+  job->key = responseKey(job->format,source(),statements,sq,page,orderKey);
+  if (writeCurrentResponse(request,connection,statements,job->key,contentType(job->format),job->coding,job->etag,job->generation))
+    return;
+  runQueries(request,connection,boost::bind(&queryResults,job,stmt,sq,page,orderKey));
+}
+
+void ResourceHandler::writeExpandedResults(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection, const std::vector<Expansion>& levels, const SanitizedParams& sq) {
+  assert(!levels.empty());
+  assert(_db);
+  std::vector<std::string> statements;
+  std::vector<Expansion>::const_iterator level(levels.begin());
+  for (; level!=levels.end(); ++level)
+    statements.push_back(level->statement);
+  const ResultsJobPtr job(new ResultsJob(request,connection,_db,resultFormat(*request),_compressionLevel ? contentCoding(*request) : std::string(),_compressionLevel,_chunkSize,_responses,_executor));
+  job->key = responseKey(job->format,source(),statements,sq,PageParams(),std::string());
+  if (writeCurrentResponse(request,connection,statements,job->key,contentType(job->format),job->coding,job->etag,job->generation))
+    return;
+  runQueries(request,connection,boost::bind(&expandedResults,job,levels,sq));
+}
+
+void ResourceHandler::runQueries(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection, const DBExecutor::Work& work) {
+  if (!_executor)
+    work();
+  else if (!_executor->trySubmit(work))
+    writeJsonErrorResponse(request,connection,serviceUnavailableCode,serviceUnavailableMessage,"too many requests are waiting for the database");
+}
+
+bool ResourceHandler::writeCurrentResponse(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection, const std::vector<std::string>& statements, const std::string& key, const std::string& contentType, const std::string& coding, std::string& etag, boost::uint64_t& generation) const {
+  const boost::shared_ptr<SQLiteDB> sqlite(boost::dynamic_pointer_cast<SQLiteDB>(_db));
+  etag.clear();
+  if (!sqlite)
+    return false;
+  // the generation is taken before the response is made, so a write committed while it's being
+  // made leaves it tagged with a generation that is already out of date rather than a current one
+  generation = 0;
+  std::vector<std::string>::const_iterator stmt(statements.begin());
+  for (; stmt!=statements.end(); ++stmt) {
+    boost::uint64_t g(0);
     std::string errMsg;
-    const std::string stmt(listStatement());
-    assert(!stmt.empty());
-    assert(_db);
-    if (_db->execute(stmt,errMsg,boost::bind(&Lister::callback,boost::ref(l),_1,_2,_3))) {
-      l.finish();
-      writeJsonHttpResponse(
-			    *l._doc,
-			    *pion::net::HTTPResponseWriter::create(
-								   connection,
-								   *request,
-								   boost::bind(&pion::net::TCPConnection::finish, connection)));
+    if (!sqlite->generation(*stmt,g,errMsg))
+      return false;
+    generation += g;
+  }
+  etag = responseETag(key,generation);
+  // If-None-Match compares etags weakly, so the client's copy is current whichever coding it's in
+  const std::string& ifNoneMatch(request->getHeader(ifNoneMatchHeader));
+  const bool unchangedPlain(etagListed(ifNoneMatch,etag));
+  const bool unchanged(unchangedPlain || (!coding.empty() && etagListed(ifNoneMatch,codedETag(etag,coding))));
+  ResponseCache::Body body(!unchanged && _responses ? _responses->find(key,generation) : ResponseCache::Body());
+  if (!unchanged && !body)
+    return false;
+  // cached bodies are compressed by the first request that asks for a coding, and the compressed
+  // variant is kept with them for as long as their generation is current
+  const bool compress(!coding.empty() && (unchanged ? !unchangedPlain : body->size() >= MIN_COMPRESSED_SIZE));
+  if (body && compress) {
+    ResponseCache::Body compressed(_responses->findVariant(key,generation,coding));
+    if (!compressed) {
+      compressed = compressedBody(*body,coding,_compressionLevel);
+      _responses->insertVariant(key,generation,coding,compressed);
     }
+    body = compressed;
+  }
+  const pion::net::HTTPResponseWriterPtr writer(
+					      pion::net::HTTPResponseWriter::create(
+										    connection,
+										    *request,
+										    boost::bind(&finishCachedResponse, connection, body)));
+  if (unchanged) {
+    writer->getResponse().setStatusCode(pion::net::HTTPTypes::RESPONSE_CODE_NOT_MODIFIED);
+    writer->getResponse().setStatusMessage(pion::net::HTTPTypes::RESPONSE_MESSAGE_NOT_MODIFIED);
+    writer->getResponse().setDoNotSendContentLength();
+  } else {
+    writer->getResponse().setStatusCode(pion::net::HTTPTypes::RESPONSE_CODE_OK);
+    writer->getResponse().setStatusMessage(pion::net::HTTPTypes::RESPONSE_MESSAGE_OK);
+    setFormatHeaders(writer->getResponse(),contentType);
+    if (compress)
+      writer->getResponse().addHeader(contentEncodingHeader,coding);
+    writer->writeNoCopy(*body);
+  }
+  writer->getResponse().addHeader(etagHeader,compress ? codedETag(etag,coding) : etag);
+  writer->getResponse().addHeader(varyHeader,negotiatedHeaders);
+  writer->send();
+  return true;
+}
+
+bool ResourceHandler::sanitizePageParams(const pion::net::HTTPTypes::QueryParams& dirtyParams, PageParams& page, std::string& orderKey, std::string& errorMessage) const {
+  const pion::net::HTTPTypes::QueryParams::const_iterator limit(dirtyParams.find(limitParam));
+  const pion::net::HTTPTypes::QueryParams::const_iterator order(dirtyParams.find(orderParam));
+  const pion::net::HTTPTypes::QueryParams::const_iterator after(dirtyParams.find(afterParam));
+  const pion::net::HTTPTypes::QueryParams::const_iterator end(dirtyParams.end());
+  if (limit == end && order == end && after == end)
+    return true;
+  // keys are whitelisted by the same sanitizer that handles search params, so only the
+  // columns that can be searched on can be ordered by
+  pion::net::HTTPTypes::QueryParams keyParams;
+  keyParams.insert(std::make_pair(idKey,std::string()));
+  const SanitizedParams key(sanitizeQueryParams(keyParams));
+  if (key.size() != 1) {
+    errorMessage = "paging is not supported by " + source();
+    return false;
+  }
+  page.keyColumn = key.begin()->first;
+  page.orderColumn = page.keyColumn;
+  const SanitizedParam::Type keyType(key.begin()->second.type);
+  SanitizedParam::Type orderType(keyType);
+  orderKey = idKey;
+  if (order != end) {
+    std::string dirtyKey(order->second);
+    page.descending = !dirtyKey.empty() && dirtyKey[0] == '-';
+    if (page.descending)
+      dirtyKey.erase(0,1);
+    keyParams.clear();
+    keyParams.insert(std::make_pair(dirtyKey,std::string()));
+    const SanitizedParams orderColumn(sanitizeQueryParams(keyParams));
+    if (orderColumn.size() != 1) {
+      errorMessage = "can't order by " + order->second;
+      return false;
+    }
+    page.orderColumn = orderColumn.begin()->first;
+    orderType = orderColumn.begin()->second.type;
+    orderKey = dirtyKey;
+  }
+  if (limit != end) {
+    const char* const begin(limit->second.c_str());
+    char* last(0);
+    errno = 0;
+    const unsigned long value(strtoul(begin,&last,10));
+    if (errno != 0 || last == begin || *last != '\0' || value < 1 || value > MAX_PAGE_SIZE) {
+      std::ostringstream ss;
+      ss << "limit must be a number between 1 and " << MAX_PAGE_SIZE;
+      errorMessage = ss.str();
+      return false;
+    }
+    page.limit = value;
+  }
+  if (after != end) {
+    // the id comes first since it never contains a colon, while a text order value may.
+    // pion leaves query values url encoded, and clients will usually encode the colon
+    const std::string cursor(pion::net::HTTPTypes::url_decode(after->second));
+    const std::string::size_type colon(cursor.find(':'));
+    const bool orderedById(page.orderColumn == page.keyColumn);
+    if (cursor.empty() || colon == 0 || (orderedById && colon != std::string::npos)) {
+      errorMessage = "malformed after cursor " + cursor;
+      return false;
+    }
+    page.hasAfter = true;
+    page.afterKey = SanitizedParam(cursor.substr(0,colon),keyType);
+    if (colon != std::string::npos)
+      page.afterOrder = SanitizedParam(cursor.substr(colon+1),orderType);
+    else
+      page.afterOrderIsNull = !orderedById;
+    if (!integerParam(page.afterKey) || !integerParam(page.afterOrder)) {
+      errorMessage = "malformed after cursor " + cursor;
+      return false;
+    }
+  }
+  return true;
+}
+
+void ResourceHandler::list(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection) {
+  PageParams page;
+  std::string orderKey, errMsg;
+  if (!sanitizePageParams(request->getQueryParams(),page,orderKey,errMsg))
+    writeJsonErrorResponse(request,connection,pion::net::HTTPTypes::RESPONSE_CODE_BAD_REQUEST,pion::net::HTTPTypes::RESPONSE_MESSAGE_BAD_REQUEST,errMsg);
+  else if (request->hasQuery(expandParam))
+    expand(request,connection,SanitizedParams(),page);
+  else if (page.empty())
+    writeQueryResults(request,connection,listStatement(),SanitizedParams());
+  else
+    writeQueryResults(request,connection,viewStatement(),SanitizedParams(),page,orderKey);
 }
 
 void ResourceHandler::view(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection) {
   SanitizedParams sq(sanitizeQueryParams(request->getQueryParams()));
+  PageParams page;
+  std::string orderKey, errMsg;
   if (sq.empty()) 
     list(request,connection); // no search params is the same as listing everything
-  else {
-    Lister l;
-    std::string errMsg;
-    const std::string stmt(viewStatement());
-    assert(!stmt.empty());
-    if (_db->execute(stmt,errMsg,boost::bind(&Lister::callback,boost::ref(l),_1,_2,_3),sq)) {
-      l.finish();
-      writeJsonHttpResponse(
-			    *l._doc,
-			    *pion::net::HTTPResponseWriter::create(
-								   connection,
-								   *request,
-								   boost::bind(&pion::net::TCPConnection::finish, connection)));
-    }    
+  else if (!expandValueLists(sq,errMsg) || !sanitizePageParams(request->getQueryParams(),page,orderKey,errMsg))
+    writeJsonErrorResponse(request,connection,pion::net::HTTPTypes::RESPONSE_CODE_BAD_REQUEST,pion::net::HTTPTypes::RESPONSE_MESSAGE_BAD_REQUEST,errMsg);
+  else if (request->hasQuery(expandParam))
+    expand(request,connection,sq,page);
+  else
+    writeQueryResults(request,connection,viewStatement(),sq,page,orderKey);
+}
+
+void ResourceHandler::expand(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection, const SanitizedParams& sq, const PageParams& page) {
+  const std::string expand(pion::net::HTTPTypes::url_decode(request->getQuery(expandParam)));
+  std::vector<Expansion> levels;
+  if (!page.empty())
+    writeJsonErrorResponse(request,connection,pion::net::HTTPTypes::RESPONSE_CODE_BAD_REQUEST,pion::net::HTTPTypes::RESPONSE_MESSAGE_BAD_REQUEST,"expanded results can't be paged");
+  else if (!expansion(expand,levels))
+    writeJsonErrorResponse(request,connection,pion::net::HTTPTypes::RESPONSE_CODE_BAD_REQUEST,pion::net::HTTPTypes::RESPONSE_MESSAGE_BAD_REQUEST,"can't expand " + source() + " by " + expand);
+  else
+    writeExpandedResults(request,connection,levels,sq);
+}
+
+namespace {
+  // adds the steps of the query's plan that scan rather than search a table to scans
+  bool addScans(const SQLiteDB& sqlite, const std::string& stmt, const SanitizedParams& sq, const PageParams& page, const std::string& lookup, std::string& scans, std::string& errorMessage) {
+    std::vector<std::string> details;
+    if (!sqlite.explainQueryPlan(stmt,sq,page,details,errorMessage))
+      return false;
+    std::vector<std::string>::const_iterator detail(details.begin());
+    for (; detail!=details.end(); ++detail) {
+      if (detail->compare(0,4,"SCAN") == 0)
+	scans += (scans.empty() ? "" : ", ") + lookup + " (" + *detail + ")";
+    }
+    return true;
+  }
+}
+
+bool ResourceHandler::checkQueryPlans(std::string& errorMessage) const {
+  const boost::shared_ptr<SQLiteDB> sqlite(boost::dynamic_pointer_cast<SQLiteDB>(_db));
+  const std::string stmt(viewStatement());
+  std::vector<std::string> keys;
+  if (!sqlite || stmt.empty())
+    return true;
+  if (!searchKeys(keys,errorMessage))
+    return false;
+  std::string scans;
+  std::vector<std::string>::const_iterator key(keys.begin());
+  for (; key!=keys.end(); ++key) {
+    pion::net::HTTPTypes::QueryParams dirtyParams;
+    dirtyParams.insert(std::make_pair(*key,std::string()));
+    const SanitizedParams sq(sanitizeQueryParams(dirtyParams));
+    if (!addScans(*sqlite,stmt,sq,PageParams(),source() + " by " + *key,scans,errorMessage))
+      return false;
+  }
+  // pages of list and view can be ordered by any search key either way, and go on after the row
+  // of the previous page. the id of that row is the whole cursor when they are ordered by id
+  const char* const orders[] = { "", "-" };
+  for (key = keys.begin(); key!=keys.end(); ++key) {
+    const std::string cursor(*key == idKey ? "1" : "1:1");
+    for (size_t o(0); o<2; ++o) {
+      pion::net::HTTPTypes::QueryParams dirtyParams;
+      dirtyParams.insert(std::make_pair(orderParam,orders[o] + *key));
+      dirtyParams.insert(std::make_pair(afterParam,cursor));
+      PageParams page;
+      std::string orderKey;
+      if (!sanitizePageParams(dirtyParams,page,orderKey,errorMessage) ||
+	  !addScans(*sqlite,stmt,SanitizedParams(),page,source() + " ordered by " + orders[o] + *key,scans,errorMessage))
+	return false;
+    }
+  }
+  if (scans.empty())
+    return true;
+  errorMessage = "full scans in " + scans;
+  return false;
+}
+
+bool ResourceHandler::cacheInCatalog(std::string& errorMessage) const {
+  const boost::shared_ptr<CatalogDB> catalog(boost::dynamic_pointer_cast<CatalogDB>(_db));
+  const std::string stmt(viewStatement());
+  std::vector<std::string> keys;
+  if (!catalog || stmt.empty())
+    return true;
+  if (!searchKeys(keys,errorMessage))
+    return false;
+  // integer search params are the primary and foreign keys
+  std::vector<std::string> indexed;
+  std::vector<std::string>::const_iterator key(keys.begin());
+  for (; key!=keys.end(); ++key) {
+    pion::net::HTTPTypes::QueryParams dirtyParams;
+    dirtyParams.insert(std::make_pair(*key,std::string()));
+    const SanitizedParams sq(sanitizeQueryParams(dirtyParams));
+    if (sq.begin()->second.type == SanitizedParam::Integer)
+      indexed.push_back(sq.begin()->first);
+  }
+  return catalog->cacheView(stmt,indexed,errorMessage);
+}
+
+bool ResourceHandler::searchKeys(std::vector<std::string>& keys, std::string& errorMessage) const {
+  const boost::shared_ptr<SQLiteDB> sqlite(boost::dynamic_pointer_cast<SQLiteDB>(_db));
+  assert(sqlite);
+  // the search params are the result columns the sanitizer lets through
+  std::vector<std::string> columns;
+  if (!sqlite->columnNames(viewStatement(),columns,errorMessage))
+    return false;
+  std::vector<std::string>::const_iterator column(columns.begin());
+  for (; column!=columns.end(); ++column) {
+    pion::net::HTTPTypes::QueryParams dirtyParams;
+    dirtyParams.insert(std::make_pair(*column,std::string()));
+    if (!sanitizeQueryParams(dirtyParams).empty())
+      keys.push_back(*column);
   }
+  return true;
+}
+
+void ResourceHandler::setChunkSize(const size_t chunkSize) {
+  _chunkSize = chunkSize;
+}
+
+void ResourceHandler::setCompressionLevel(const int level) {
+  _compressionLevel = level;
+}
+
+void ResourceHandler::setResponseCache(const boost::shared_ptr<ResponseCache>& cache) {
+  _responses = cache;
+}
+
+const boost::shared_ptr<ResponseCache>& ResourceHandler::responseCache() const {
+  return _responses;
+}
+
+void ResourceHandler::setExecutor(const boost::shared_ptr<DBExecutor>& executor) {
+  _executor = executor;
+}
+
+const boost::shared_ptr<DBExecutor>& ResourceHandler::executor() const {
+  return _executor;
 }
 
 const std::string& ResourceHandler::source() const {
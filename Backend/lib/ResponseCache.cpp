@@ -0,0 +1,97 @@
+#include "ResponseCache.h"
+
+ResponseCache::ResponseCache(const size_t capacity)
+  : _capacity(capacity)
+  , _size(0)
+  , _variants(0)
+  , _hits(0)
+  , _misses(0) {
+}
+
+ResponseCache::Body ResponseCache::find(const std::string& key, const boost::uint64_t generation) {
+  boost::mutex::scoped_lock lock(_mutex);
+  const Index::iterator found(_index.find(key));
+  if (found == _index.end() || found->second->generation != generation) {
+    // generations only go up, so a body older than the one asked for is never asked for again.
+    // a newer one is kept, the request asking was merely behind a concurrent write
+    if (found != _index.end() && found->second->generation < generation)
+      erase(found);
+    ++_misses;
+    return Body();
+  }
+  _entries.splice(_entries.begin(),_entries,found->second);
+  ++_hits;
+  return found->second->body;
+}
+
+void ResponseCache::insert(const std::string& key, const boost::uint64_t generation, const Body& body) {
+  assert(body);
+  if (body->size() > _capacity)
+    return;
+  boost::mutex::scoped_lock lock(_mutex);
+  const Index::iterator found(_index.find(key));
+  if (found != _index.end()) {
+    // a concurrent request may have built it from newer data already
+    if (found->second->generation > generation)
+      return;
+    erase(found);
+  }
+  _entries.push_front(Entry(key,generation,body));
+  _index.insert(std::make_pair(key,_entries.begin()));
+  _size += body->size();
+  evict();
+}
+
+ResponseCache::Body ResponseCache::findVariant(const std::string& key, const boost::uint64_t generation, const std::string& variant) {
+  boost::mutex::scoped_lock lock(_mutex);
+  const Index::const_iterator found(_index.find(key));
+  if (found == _index.end() || found->second->generation != generation)
+    return Body();
+  const std::map<std::string,Body>::const_iterator it(found->second->variants.find(variant));
+  return it == found->second->variants.end() ? Body() : it->second;
+}
+
+void ResponseCache::insertVariant(const std::string& key, const boost::uint64_t generation, const std::string& variant, const Body& body) {
+  assert(body);
+  boost::mutex::scoped_lock lock(_mutex);
+  const Index::iterator found(_index.find(key));
+  if (found == _index.end() || found->second->generation != generation)
+    return;
+  Entry& entry(*found->second);
+  Body& existing(entry.variants[variant]);
+  if (existing) {
+    entry.size -= existing->size();
+    _size -= existing->size();
+  } else
+    ++_variants;
+  existing = body;
+  entry.size += body->size();
+  _size += body->size();
+  // the entry may have grown too large to keep on its own
+  evict();
+}
+
+ResponseCache::Stats ResponseCache::stats() const {
+  boost::mutex::scoped_lock lock(_mutex);
+  Stats s;
+  s.size = _size;
+  s.capacity = _capacity;
+  s.entries = _entries.size();
+  s.variants = _variants;
+  s.hits = _hits;
+  s.misses = _misses;
+  return s;
+}
+
+// drops the least recently used entries until the cache fits its capacity again
+void ResponseCache::evict() {
+  while (_size > _capacity)
+    erase(_index.find(_entries.back().key));
+}
+
+void ResponseCache::erase(const Index::iterator& it) {
+  _size -= it->second->size;
+  _variants -= it->second->variants.size();
+  _entries.erase(it->second);
+  _index.erase(it);
+}
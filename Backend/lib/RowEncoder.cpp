@@ -0,0 +1,59 @@
+#include "RowEncoder.h"
+#include <algorithm>
+#include <cstring>
+
+const unsigned int RowEncoder::FORMAT_VERSION;
+
+RowEncoder::RowEncoder(BufferPool& pool)
+  : _pool(pool)
+  , _size(0) {
+}
+
+RowEncoder::~RowEncoder() {
+}
+
+void RowEncoder::row(const ResultRow& row) {
+  openRow(row);
+  closeRow();
+}
+
+void RowEncoder::clear() {
+  _buffers.clear();
+  _size = 0;
+}
+
+void RowEncoder::takeBuffers(Buffers& out) {
+  out.clear();
+  out.swap(_buffers);
+  _size = 0;
+}
+
+const RowEncoder::Buffers& RowEncoder::buffers() const {
+  return _buffers;
+}
+
+size_t RowEncoder::size() const {
+  return _size;
+}
+
+void RowEncoder::append(const char* data, size_t size) {
+  _size += size;
+  while (size) {
+    if (_buffers.empty() || _buffers.back()->available() == 0)
+      _buffers.push_back(_pool.acquire());
+    BufferPool::Buffer& b(*_buffers.back());
+    const size_t n(std::min(size,b.available()));
+    memcpy(b.data()+b._size,data,n);
+    b._size += n;
+    data += n;
+    size -= n;
+  }
+}
+
+void RowEncoder::append(const char c) {
+  if (_buffers.empty() || _buffers.back()->available() == 0)
+    _buffers.push_back(_pool.acquire());
+  BufferPool::Buffer& b(*_buffers.back());
+  b.data()[b._size++] = c;
+  ++_size;
+}
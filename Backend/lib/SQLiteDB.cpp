@@ -1,111 +1,402 @@
 #include "SQLiteDB.h"
+#include "SQLiteRow.h"
 #include "Conf.h"
+#include <boost/bind.hpp>
+#include <boost/next_prior.hpp>
+#include <cstring>
+#include <iterator>
+#include <sstream>
 
-SQLiteDB::SQLiteDB() 
+SQLiteDB::SQLiteDB(const size_t writeBatchSize, const size_t writeBatchLatency, const bool walMode)
   : _db(0) {
   const int ret(sqlite3_open(DB_CACHE,&_db));
   if (ret) {
     std::cerr << "Couldn't open caching database " << DB_CACHE << ". Reason: " << sqlite3_errmsg(_db) << std::endl;
     exit(1);
   }
+  sqlite3_busy_timeout(_db,DB_BUSY_TIMEOUT);
+  // the journal mode can't be changed from inside the write queue's transactions
+  if (walMode && sqlite3_exec(_db,"PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;",0,0,0) != SQLITE_OK) {
+    std::cerr << "Unable to switch caching database " << DB_CACHE << " to WAL mode. Reason: " << sqlite3_errmsg(_db) << std::endl;
+    exit(1);
+  }
+  sqlite3_update_hook(_db,&SQLiteDB::updateHook,this);
+  sqlite3_set_authorizer(_db,&SQLiteDB::authorize,this);
+  _statements.reset(new SQLiteStatementCache(_db));
+  _writes.reset(new SQLiteWriteQueue(_db,writeBatchSize,boost::posix_time::milliseconds(writeBatchLatency)));
+  _writes->setBatchCallback(boost::bind(&SQLiteDB::batchWritten,this));
 }
 
 SQLiteDB::~SQLiteDB() {
+  // pending writes go out first, and cached statements have to be finalized before the connection can close
+  _writes.reset();
+  _statements.reset();
   if (_db) {
     sqlite3_close(_db);
   }
 }
 
 namespace {
-  int execCallback(void* _callback, int colCount, char** colValues, char** colNames) {
-    if (_callback) {
-      const SQLiteDB::ExecuteCallback& callback = *(const SQLiteDB::ExecuteCallback*)(_callback);
-      callback(colCount, colValues, colNames);
+  // steps a statement checked out of a statement cache and hands it back once it's destroyed
+  class SQLiteCursor : public Cursor {
+  public:
+    SQLiteCursor(sqlite3* db, SQLiteStatementCache& cache, const std::string& key, sqlite3_stmt* stmt)
+      : _db(db), _cache(cache), _key(key), _stmt(stmt), _row(stmt), _ret(SQLITE_OK) {}
+
+    virtual ~SQLiteCursor() {
+      _cache.release(_key,_stmt);
+    }
+
+    virtual bool next() {
+      if (_ret != SQLITE_OK && _ret != SQLITE_ROW)
+	return false;
+      _ret = sqlite3_step(_stmt);
+      if (_ret == SQLITE_ROW)
+	return true;
+      if (_ret != SQLITE_DONE)
+	_errorMessage = sqlite3_errmsg(_db);
+      return false;
+    }
+
+    virtual const ResultRow& row() const {
+      return _row;
     }
-    return 0;
-  }
 
-  struct Finalizer {
-    Finalizer(sqlite3_stmt* stmt) : _stmt(stmt) {}
-    ~Finalizer() {
-      sqlite3_finalize(_stmt);
+    virtual bool failed(std::string& errorMessage) const {
+      if (_errorMessage.empty())
+	return false;
+      errorMessage = _errorMessage;
+      return true;
     }
+
+  private:
+    sqlite3* const _db;
+    SQLiteStatementCache& _cache;
+    const std::string _key;
     sqlite3_stmt* const _stmt;
+    const SQLiteRow _row;
+    int _ret;
+    std::string _errorMessage;
   };
+
+  // multi-valued keys are matched with an IN list padded to the next power of two, by repeating
+  // the last value, so that lookups of any number of values share a handful of statements
+  size_t inListSize(const size_t values) {
+    size_t size(1);
+    while (size < values)
+      size <<= 1;
+    return size;
+  }
+
+  // the rows behind a page's after values are a single range of the order index, except where
+  // nulls are involved: they sort first, so in descending order the rows with a null order value
+  // follow those below the after value, and in ascending order the rows with a value follow the
+  // nulls behind an after row without one. conditions taking in both can't be searched for in
+  // the index, so the head of the page reads the range and a second statement its null tail
+  enum PagePart { Head, Tail };
+
+  bool orderedByKey(const PageParams& page) {
+    return page.orderColumn.empty() || page.orderColumn == page.keyColumn;
+  }
+
+  bool hasTail(const PageParams& page) {
+    return page.hasAfter && !orderedByKey(page) && page.descending != page.afterOrderIsNull;
+  }
+
+  // statements are cached under the base query plus the names and list sizes of the params bound
+  // to it and the shape of the page, which is everything that determines the generated sql
+  std::string statementKey(const std::string& query, const SanitizedParams& sp, const PageParams& page, const PagePart part) {
+    std::string key(query);
+    SanitizedParams::const_iterator it(sp.begin());
+    const SanitizedParams::const_iterator end(sp.end());
+    while (it!=end) {
+      const SanitizedParams::const_iterator next(sp.upper_bound(it->first));
+      std::ostringstream ss;
+      ss << '\0' << it->first << '\0' << inListSize(std::distance(it,next));
+      key += ss.str();
+      it = next;
+    }
+    if (!page.empty()) {
+      std::vector<std::string>::const_iterator group(page.groupColumns.begin());
+      for (; group!=page.groupColumns.end(); ++group)
+	key += '\0' + *group;
+      key += '\0';
+      key += page.orderColumn + '\0' + page.keyColumn + '\0';
+      key += page.descending ? 'd' : 'a';
+      key += page.limit ? 'l' : '-';
+      key += part == Tail ? 't' : page.hasAfter ? (page.afterOrderIsNull ? 'n' : 'v') : '-';
+    }
+    return key;
+  }
+
+  // where clause condition selecting the page's part of the rows behind its after values. the
+  // value conditions are written so that the order column is bounded on its own, which is what
+  // lets them be searched for in the index rather than filtering a scan of it. null order values
+  // are matched with a null bound to IS ?, since sqlite folds IS NULL into a constant on not null
+  // columns and then explains it as a scan, even though it reads nothing
+  std::string keysetCondition(const PageParams& page, const PagePart part) {
+    const std::string& o(page.orderColumn);
+    const std::string& k(page.keyColumn);
+    if (part == Tail)
+      return o + (page.descending ? " IS ?" : " IS NOT NULL");
+    const char* const cmp(page.descending ? " < ?" : " > ?");
+    if (orderedByKey(page))
+      return k + cmp;
+    if (page.afterOrderIsNull)
+      return o + " IS ? AND " + k + cmp;
+    return o + (page.descending ? " <= ?" : " >= ?") + " AND (" + o + cmp + " OR " + k + cmp + ")";
+  }
+
+  std::string parameterizedQuery(const std::string& query, const SanitizedParams& sp, const PageParams& page, const PagePart part) {
+    if (sp.empty() && page.empty())
+      return query;
+    // generate a parameterized where clause for the query
+    std::string whereClause;
+    SanitizedParams::const_iterator it(sp.begin());
+    const SanitizedParams::const_iterator end(sp.end());
+    while (it!=end) {
+      const SanitizedParams::const_iterator next(sp.upper_bound(it->first));
+      const size_t values(inListSize(std::distance(it,next)));
+      whereClause += whereClause.empty() ? " WHERE " : " AND ";
+      whereClause += it->first;
+      if (values == 1)
+	whereClause += " = ?";
+      else {
+	whereClause += " IN (?";
+	for (size_t i(1); i<values; ++i)
+	  whereClause += ",?";
+	whereClause += ")";
+      }
+      it = next;
+    }
+    if (page.hasAfter) {
+      whereClause += whereClause.empty() ? " WHERE " : " AND ";
+      whereClause += keysetCondition(page,part);
+    }
+    if (!page.empty()) {
+      const char* const direction(page.descending ? " DESC" : " ASC");
+      whereClause += " ORDER BY ";
+      std::vector<std::string>::const_iterator group(page.groupColumns.begin());
+      for (; group!=page.groupColumns.end(); ++group)
+	whereClause += *group + ", ";
+      if (!orderedByKey(page))
+	whereClause += page.orderColumn + direction + ", ";
+      whereClause += page.keyColumn + direction;
+      if (page.limit)
+	whereClause += " LIMIT ?";
+    }
+    whereClause += ";";
+    return query+whereClause;
+  }
+
+  // integer params that don't parse as such are bound as text, so they still simply match nothing.
+  // text is copied since cursors may be stepped long after the params they were opened with are gone
+  int bindParam(sqlite3_stmt* stmt, const int index, const SanitizedParam& param) {
+    boost::int64_t value;
+    if (param.type == SanitizedParam::Integer && param.integerValue(value))
+      return sqlite3_bind_int64(stmt,index,value);
+    return sqlite3_bind_text(stmt,index,param.value.c_str(), param.value.size(), SQLITE_TRANSIENT);
+  }
 }
 
 bool SQLiteDB::execute(const std::string& query, std::string& errorMessage, const ExecuteCallback& callback, const SanitizedParams& sp) const {
-  int ret(-1);
   assert(!query.empty());
-  if (sp.empty() ) {
-    char* errMsg = 0;
-    ret = sqlite3_exec(_db, query.c_str(), execCallback, (void*)&callback, &errMsg);
-    if (errMsg) {
-      errorMessage = errMsg;
-      sqlite3_free(errMsg);
-    }
-  } else {
-    // generate a parameterized where clause for the query
-    std::string whereClause(" WHERE ");
+  // statements without results (schema changes, inserts) may contain several
+  // statements and are run once, so there is no point in caching them
+  if (!callback)
+    return _writes->execute(query,errorMessage);
+  const CursorPtr cursor(openCursor(query,errorMessage,sp,PageParams()));
+  if (!cursor)
+    return false;
+  while (cursor->next())
+    callback(cursor->row());
+  return !cursor->failed(errorMessage);
+}
+
+CursorPtr SQLiteDB::openCursor(const std::string& query, std::string& errorMessage, const SanitizedParams& sp, const PageParams& page) const {
+  return openCachedCursor(_db,*_statements,query,errorMessage,sp,page);
+}
+
+namespace {
+  CursorPtr openPart(sqlite3* db, SQLiteStatementCache& statements, const std::string& query, std::string& errorMessage, const SanitizedParams& sp, const PageParams& page, const PagePart part) {
+    assert(!query.empty());
+    const std::string key(statementKey(query,sp,page,part));
+    sqlite3_stmt* const stmt(statements.acquire(key,parameterizedQuery(query,sp,page,part),errorMessage));
+    if (!stmt)
+      return CursorPtr();
+    const CursorPtr cursor(new SQLiteCursor(db,statements,key,stmt));
+    int ret(SQLITE_OK);
+    int i(1);
     SanitizedParams::const_iterator it(sp.begin());
     const SanitizedParams::const_iterator end(sp.end());
-    bool notFirst(false);
-    for (; it!=end; ++it) {
-      if (notFirst)
-	whereClause += " AND ";
-      else
-	notFirst = true;
-      whereClause += it->first + " = ?";
+    while (it!=end && ret == SQLITE_OK) {
+      const SanitizedParams::const_iterator next(sp.upper_bound(it->first));
+      size_t padding(inListSize(std::distance(it,next)));
+      for (; it!=next && ret == SQLITE_OK; ++it, --padding)
+	ret = bindParam(stmt,i++,it->second);
+      for (const SanitizedParam& last(boost::prior(next)->second); padding && ret == SQLITE_OK; --padding)
+	ret = bindParam(stmt,i++,last);
     }
-    whereClause += ";";
-    const std::string newQuery(query+whereClause);
-    // now prep, bind, and step this mofo
-    sqlite3_stmt* stmt;
-    ret = sqlite3_prepare(_db, newQuery.c_str(), -1, &stmt, 0);
-    Finalizer f(stmt);
-    if (ret == SQLITE_OK) {
-      it = sp.begin();
-      int i(1);
-      for (; it!=end; ++it) {
-
-	ret = sqlite3_bind_text(stmt,i,it->second.c_str(), it->second.size(), SQLITE_STATIC);
-	if (ret != SQLITE_OK)
-	  break;
-	++i;
+    if (page.hasAfter && !orderedByKey(page) && ret == SQLITE_OK) {
+      if (part == Tail ? page.descending : page.afterOrderIsNull)
+	ret = sqlite3_bind_null(stmt,i++);
+      else if (part == Head) {
+	ret = bindParam(stmt,i++,page.afterOrder);
+	if (ret == SQLITE_OK)
+	  ret = bindParam(stmt,i++,page.afterOrder);
       }
+    }
+    if (page.hasAfter && part == Head && ret == SQLITE_OK)
+      ret = bindParam(stmt,i++,page.afterKey);
+    if (page.limit && ret == SQLITE_OK)
+      ret = sqlite3_bind_int64(stmt,i++,page.limit);
+    if (ret != SQLITE_OK) {
+      errorMessage = sqlite3_errmsg(db);
+      return CursorPtr();
+    }
+    return cursor;
+  }
+
+  // reads a page's head and then its tail, stopping after limit rows between them
+  class TailedCursor : public Cursor {
+  public:
+    TailedCursor(const CursorPtr& head, const CursorPtr& tail, const size_t limit)
+      : _head(head), _tail(tail), _current(head), _limit(limit), _rows(0) {}
 
-      if (ret == SQLITE_OK) {
-	std::vector<char*> colNames;
-	std::vector<char*> colValues;
-	int colCount(-1);
-	while (true) {
-	  ret = sqlite3_step(stmt);
-	  if (ret == SQLITE_ROW) {
-	    if (colCount<0L) {
-	      // initialize
-	      colCount = sqlite3_column_count(stmt);
-	      if (colCount==0) {
-		callback(colCount,NULL,NULL);
-		return true; // empty results. done
-	      }
-	      for (int i(0); i<colCount; ++i) {
-		colNames.push_back((char*)sqlite3_column_name(stmt,i));
-	      }
-	    }
-	    for (int i(0); i<colCount; ++i) {
-	      colValues.push_back((char*)sqlite3_column_text(stmt,i));
-	    }
-	    callback(colCount,
-		     &(*colValues.begin()),
-		     &(*colNames.begin()));
-
-	  } else
-	    break;
-	}
+    virtual bool next() {
+      if (_limit && _rows == _limit)
+	return false;
+      if (!_current->next()) {
+	std::string errorMessage;
+	if (_current == _tail || _head->failed(errorMessage))
+	  return false;
+	_current = _tail;
+	if (!_current->next())
+	  return false;
       }
+      ++_rows;
+      return true;
+    }
+
+    virtual const ResultRow& row() const {
+      return _current->row();
+    }
+
+    virtual bool failed(std::string& errorMessage) const {
+      return _head->failed(errorMessage) || _tail->failed(errorMessage);
+    }
+
+  private:
+    const CursorPtr _head;
+    const CursorPtr _tail;
+    CursorPtr _current;
+    const size_t _limit;
+    size_t _rows;
+  };
+}
+
+CursorPtr SQLiteDB::openCachedCursor(sqlite3* db, SQLiteStatementCache& statements, const std::string& query, std::string& errorMessage, const SanitizedParams& sp, const PageParams& page) {
+  const CursorPtr head(openPart(db,statements,query,errorMessage,sp,page,Head));
+  if (!head || !hasTail(page))
+    return head;
+  const CursorPtr tail(openPart(db,statements,query,errorMessage,sp,page,Tail));
+  if (!tail)
+    return CursorPtr();
+  return CursorPtr(new TailedCursor(head,tail,page.limit));
+}
+
+void SQLiteDB::queueWrite(const std::string& statement, const WriteCallback& callback) const {
+  _writes->enqueue(statement,callback);
+}
+
+void SQLiteDB::waitForQueuedWrites() const {
+  _writes->flush();
+}
+
+SQLiteStatementCache::Stats SQLiteDB::statementCacheStats() const {
+  return _statements->stats();
+}
+
+SQLiteWriteQueue::Stats SQLiteDB::writeQueueStats() const {
+  return _writes->stats();
+}
+
+namespace {
+  std::string quoted(const std::string& value) {
+    std::string q(1,'\'');
+    for (std::string::const_iterator c(value.begin()); c!=value.end(); ++c) {
+      if (*c == '\'')
+	q += '\'';
+      q += *c;
     }
+    return q + '\'';
+  }
+
+  std::string textColumn(const ResultRow& row, const int column) {
+    const ResultRow::TextValue value(row.textValue(column));
+    return std::string(value.data,value.size);
+  }
+
+  void addIndexDefinition(std::map<std::string,std::string>& definitions, const ResultRow& row) {
+    definitions[textColumn(row,0)] = textColumn(row,1);
+  }
+
+  void addPlanDetail(std::vector<std::string>& details, const ResultRow& row) {
+    // the detail is the last column of explain query plan
+    details.push_back(textColumn(row,row.columnCount()-1));
   }
-  return ret == SQLITE_DONE || ret == SQLITE_OK;
+}
+
+bool SQLiteDB::ensureIndexes(const std::string& table, const std::vector<Index>& indexes, std::string& errorMessage) const {
+  if (!execute("create table if not exists schema_indexes (index_name text primary key, table_name text not null, definition text not null);",errorMessage,ExecuteCallback()))
+    return false;
+  std::map<std::string,std::string> existing;
+  SanitizedParams sp;
+  sp.insert(std::make_pair("table_name",SanitizedParam(table)));
+  // indexes dropped behind our back count as missing
+  if (!execute("select index_name, definition from schema_indexes join sqlite_master on type = 'index' and name = index_name",errorMessage,boost::bind(&addIndexDefinition,boost::ref(existing),_1),sp))
+    return false;
+  // everything that changes goes out as one statement, so the schema is updated atomically
+  std::string changes;
+  std::vector<Index>::const_iterator it(indexes.begin());
+  for (; it!=indexes.end(); ++it) {
+    const std::string definition("create index " + it->name + " on " + table + " (" + it->columns + ");");
+    const std::map<std::string,std::string>::iterator current(existing.find(it->name));
+    if (current != existing.end()) {
+      const bool unchanged(current->second == definition);
+      existing.erase(current);
+      if (unchanged)
+	continue;
+    }
+    changes += "drop index if exists " + it->name + "; " + definition;
+    changes += " insert or replace into schema_indexes (index_name, table_name, definition) values (" + quoted(it->name) + ", " + quoted(table) + ", " + quoted(definition) + ");";
+  }
+  std::map<std::string,std::string>::const_iterator stale(existing.begin());
+  for (; stale!=existing.end(); ++stale)
+    changes += "drop index if exists " + stale->first + "; delete from schema_indexes where index_name = " + quoted(stale->first) + ";";
+  return changes.empty() || execute(changes,errorMessage,ExecuteCallback());
+}
+
+bool SQLiteDB::columnNames(const std::string& query, std::vector<std::string>& names, std::string& errorMessage) const {
+  sqlite3_stmt* const stmt(_statements->acquire(query,query,errorMessage));
+  if (!stmt)
+    return false;
+  const int colCount(sqlite3_column_count(stmt));
+  for (int i(0); i<colCount; ++i)
+    names.push_back(sqlite3_column_name(stmt,i));
+  _statements->release(query,stmt);
+  return true;
+}
+
+bool SQLiteDB::explainQueryPlan(const std::string& query, const SanitizedParams& sp, const PageParams& page, std::vector<std::string>& details, std::string& errorMessage) const {
+  // explaining never checks whether the schema a connection has loaded is current, so this goes
+  // through the connection the indexes were created on rather than one that may predate them
+  const CursorPtr cursor(SQLiteDB::openCursor("explain query plan " + query,errorMessage,sp,page));
+  if (!cursor)
+    return false;
+  while (cursor->next())
+    addPlanDetail(details,cursor->row());
+  return !cursor->failed(errorMessage);
 }
 
 JSONObjectPtr SQLiteDB::select(const std::string& fromSource) const {
@@ -115,3 +406,119 @@ JSONObjectPtr SQLiteDB::select(const std::string& fromSource) const {
 JSONObjectPtr SQLiteDB::selectWhere(const std::string& fromSource, const std::pair<const std::string,const std::string>& query) const {
   return JSONObjectPtr(new json::Object());
 }
+
+bool SQLiteDB::generation(const std::string& query, boost::uint64_t& generation, std::string& errorMessage) const {
+  std::vector<std::string> tables;
+  bool known(false);
+  {
+    boost::mutex::scoped_lock lock(_generationsMutex);
+    const std::map<std::string,std::vector<std::string> >::const_iterator found(_queryTables.find(query));
+    if (found != _queryTables.end()) {
+      tables = found->second;
+      known = true;
+    }
+  }
+  if (!known) {
+    if (!tablesRead(query,tables,errorMessage))
+      return false;
+    boost::mutex::scoped_lock lock(_generationsMutex);
+    _queryTables[query] = tables;
+  }
+  boost::mutex::scoped_lock lock(_generationsMutex);
+  generation = 0;
+  std::vector<std::string>::const_iterator table(tables.begin());
+  for (; table!=tables.end(); ++table) {
+    const std::map<std::string,boost::uint64_t>::const_iterator found(_generations.find(*table));
+    if (found != _generations.end())
+      generation += found->second;
+  }
+  return true;
+}
+
+// the program of a query opens every table and index it reads by root page, which the schema
+// maps back to the tables. like explainQueryPlan this goes through the writer connection
+bool SQLiteDB::tablesRead(const std::string& query, std::vector<std::string>& tables, std::string& errorMessage) const {
+  const CursorPtr program(SQLiteDB::openCursor("explain " + query,errorMessage));
+  if (!program)
+    return false;
+  std::set<boost::int64_t> rootPages;
+  while (program->next()) {
+    // addr, opcode, p1, p2, p3, ... where p2 is the root page and p3 the database
+    const ResultRow& op(program->row());
+    const ResultRow::TextValue opcode(op.textValue(1));
+    const std::string name(opcode.data,opcode.size);
+    if ((name == "OpenRead" || name == "ReopenIdx") && op.integerValue(4) == 0)
+      rootPages.insert(op.integerValue(3));
+  }
+  if (program->failed(errorMessage))
+    return false;
+  const CursorPtr schema(SQLiteDB::openCursor("select rootpage, tbl_name from sqlite_master",errorMessage));
+  if (!schema)
+    return false;
+  std::set<std::string> read;
+  while (schema->next()) {
+    if (rootPages.count(schema->row().integerValue(0))) {
+      const ResultRow::TextValue table(schema->row().textValue(1));
+      read.insert(std::string(table.data,table.size));
+    }
+  }
+  if (schema->failed(errorMessage))
+    return false;
+  tables.assign(read.begin(),read.end());
+  return true;
+}
+
+void SQLiteDB::rowWritten(const std::string& table, const boost::int64_t) {
+  boost::mutex::scoped_lock lock(_generationsMutex);
+  _written.insert(table);
+}
+
+void SQLiteDB::tableChanged(const std::string& table) {
+  boost::mutex::scoped_lock lock(_generationsMutex);
+  _written.insert(table);
+}
+
+void SQLiteDB::batchWritten() {
+  boost::mutex::scoped_lock lock(_generationsMutex);
+  std::set<std::string>::const_iterator table(_written.begin());
+  for (; table!=_written.end(); ++table)
+    ++_generations[*table];
+  _written.clear();
+}
+
+void SQLiteDB::updateHook(void* self, int, const char*, const char* table, sqlite3_int64 rowid) {
+  static_cast<SQLiteDB*>(self)->rowWritten(table,rowid);
+}
+
+// deletes without a where clause empty a table without reporting its rows to the update hook,
+// unless the authorizer asks for them to be deleted one by one. dropping a table is authorized
+// as a delete as well though, right after the drop itself, and ignoring that one would quietly
+// skip the drop
+int SQLiteDB::authorize(void* self, int action, const char* arg1, const char* arg2, const char*, const char*) {
+  SQLiteDB& db(*static_cast<SQLiteDB*>(self));
+  switch (action) {
+  case SQLITE_DELETE: {
+    if (!arg1 || strncmp(arg1,"sqlite_",7) == 0)
+      break;
+    boost::mutex::scoped_lock lock(db._generationsMutex);
+    if (db._dropping != arg1)
+      return SQLITE_IGNORE;
+    db._dropping.clear();
+    break;
+  }
+  case SQLITE_DROP_TABLE:
+    if (arg1) {
+      {
+	boost::mutex::scoped_lock lock(db._generationsMutex);
+	db._dropping = arg1;
+      }
+      db.tableChanged(arg1);
+    }
+    break;
+  case SQLITE_ALTER_TABLE:
+    if (arg2)
+      db.tableChanged(arg2);
+    break;
+  }
+  return SQLITE_OK;
+}
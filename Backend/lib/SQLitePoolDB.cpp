@@ -0,0 +1,73 @@
+#include "SQLitePoolDB.h"
+#include <iostream>
+
+SQLitePoolDB::Reader::Reader()
+  : _db(0) {
+  // readers are mostly used by the thread that opened them, but a streamed response may resume
+  // its cursor on another thread while the owner runs a query of its own, so keep sqlite's locking
+  const int ret(sqlite3_open_v2(DB_CACHE,&_db,SQLITE_OPEN_READONLY | SQLITE_OPEN_FULLMUTEX,0));
+  if (ret) {
+    std::cerr << "Couldn't open reader connection to caching database " << DB_CACHE << ". Reason: " << sqlite3_errmsg(_db) << std::endl;
+    exit(1);
+  }
+  sqlite3_busy_timeout(_db,DB_BUSY_TIMEOUT);
+  _statements.reset(new SQLiteStatementCache(_db));
+}
+
+SQLitePoolDB::Reader::~Reader() {
+  _statements.reset();
+  if (_db)
+    sqlite3_close(_db);
+}
+
+// WAL lets the readers keep going while the writer connection commits
+SQLitePoolDB::SQLitePoolDB(const size_t writeBatchSize, const size_t writeBatchLatency)
+  : SQLiteDB(writeBatchSize,writeBatchLatency,true)
+  , _threadReader(&SQLitePoolDB::leaveReaderToPool) {
+}
+
+SQLitePoolDB::~SQLitePoolDB() {
+  _threadReader.release();
+}
+
+void SQLitePoolDB::leaveReaderToPool(Reader*) {
+}
+
+SQLitePoolDB::Reader& SQLitePoolDB::reader() const {
+  Reader* r(_threadReader.get());
+  if (!r) {
+    const ReaderPtr newReader(new Reader);
+    {
+      boost::mutex::scoped_lock lock(_readersMutex);
+      _readers.push_back(newReader);
+    }
+    r = newReader.get();
+    _threadReader.reset(r);
+  }
+  return *r;
+}
+
+CursorPtr SQLitePoolDB::openCursor(const std::string& query, std::string& errorMessage, const SanitizedParams& sp, const PageParams& page) const {
+  Reader& r(reader());
+  return openCachedCursor(r._db,*r._statements,query,errorMessage,sp,page);
+}
+
+SQLiteStatementCache::Stats SQLitePoolDB::statementCacheStats() const {
+  SQLiteStatementCache::Stats total(SQLiteDB::statementCacheStats());
+  boost::mutex::scoped_lock lock(_readersMutex);
+  std::vector<ReaderPtr>::const_iterator it(_readers.begin());
+  const std::vector<ReaderPtr>::const_iterator end(_readers.end());
+  for (; it!=end; ++it) {
+    const SQLiteStatementCache::Stats s((*it)->_statements->stats());
+    total.size += s.size;
+    total.capacity += s.capacity;
+    total.hits += s.hits;
+    total.misses += s.misses;
+  }
+  return total;
+}
+
+size_t SQLitePoolDB::readerCount() const {
+  boost::mutex::scoped_lock lock(_readersMutex);
+  return _readers.size();
+}
@@ -0,0 +1,73 @@
+#include "SQLiteStatementCache.h"
+
+SQLiteStatementCache::SQLiteStatementCache(sqlite3* db, const size_t capacity)
+  : _db(db)
+  , _capacity(capacity)
+  , _hits(0)
+  , _misses(0) {
+  assert(_db);
+}
+
+SQLiteStatementCache::~SQLiteStatementCache() {
+  Entries::iterator it(_idle.begin());
+  const Entries::iterator end(_idle.end());
+  for (; it!=end; ++it)
+    sqlite3_finalize(it->second);
+}
+
+sqlite3_stmt* SQLiteStatementCache::acquire(const std::string& key, const std::string& sql, std::string& errorMessage) {
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    const Index::iterator found(_index.find(key));
+    if (found != _index.end()) {
+      sqlite3_stmt* const stmt(found->second->second);
+      _idle.erase(found->second);
+      _index.erase(found);
+      ++_hits;
+      return stmt;
+    }
+    ++_misses;
+  }
+  // compile outside of the lock, sqlite serializes access to the connection itself
+  sqlite3_stmt* stmt(0);
+  if (sqlite3_prepare_v2(_db, sql.c_str(), sql.size(), &stmt, 0) != SQLITE_OK) {
+    errorMessage = sqlite3_errmsg(_db);
+    sqlite3_finalize(stmt);
+    return 0;
+  }
+  return stmt;
+}
+
+void SQLiteStatementCache::release(const std::string& key, sqlite3_stmt* stmt) {
+  assert(stmt);
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  sqlite3_stmt* evicted(0);
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    if (_capacity == 0 || _index.find(key) != _index.end()) {
+      // a concurrent caller already put an identical statement back
+      evicted = stmt;
+    } else {
+      _idle.push_front(std::make_pair(key,stmt));
+      _index.insert(std::make_pair(key,_idle.begin()));
+      if (_idle.size() > _capacity) {
+	evicted = _idle.back().second;
+	_index.erase(_idle.back().first);
+	_idle.pop_back();
+      }
+    }
+  }
+  if (evicted)
+    sqlite3_finalize(evicted);
+}
+
+SQLiteStatementCache::Stats SQLiteStatementCache::stats() const {
+  boost::mutex::scoped_lock lock(_mutex);
+  Stats s;
+  s.size = _idle.size();
+  s.capacity = _capacity;
+  s.hits = _hits;
+  s.misses = _misses;
+  return s;
+}
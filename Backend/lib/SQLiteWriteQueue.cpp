@@ -0,0 +1,167 @@
+#include "SQLiteWriteQueue.h"
+#include <boost/bind.hpp>
+
+SQLiteWriteQueue::SQLiteWriteQueue(sqlite3* db, const size_t maxBatchSize, const boost::posix_time::time_duration& maxLatency)
+  : _db(db)
+  , _maxBatchSize(maxBatchSize ? maxBatchSize : 1)
+  , _maxLatency(maxLatency)
+  , _stopping(false) {
+  assert(_db);
+  _thread.reset(new boost::thread(boost::bind(&SQLiteWriteQueue::run, this)));
+}
+
+SQLiteWriteQueue::~SQLiteWriteQueue() {
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    _stopping = true;
+  }
+  _wakeup.notify_all();
+  _thread->join();
+}
+
+void SQLiteWriteQueue::enqueue(const std::string& statement, const CompletionCallback& callback) {
+  assert(!statement.empty());
+  bool wakeWriter(false);
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    _pending.push_back(Write(statement,callback));
+    // the writer only cares about the first statement of a batch and about a batch filling up
+    wakeWriter = _pending.size() == 1 || _pending.size() >= _maxBatchSize;
+  }
+  if (wakeWriter)
+    _wakeup.notify_all();
+}
+
+namespace {
+  struct Waiter {
+    Waiter() : _done(false), _ok(false) {}
+
+    void complete(bool ok, const std::string& errorMessage) {
+      {
+	boost::mutex::scoped_lock lock(_mutex);
+	_ok = ok;
+	_errorMessage = errorMessage;
+	_done = true;
+      }
+      _finished.notify_all();
+    }
+
+    bool wait(std::string& errorMessage) {
+      boost::mutex::scoped_lock lock(_mutex);
+      while (!_done)
+	_finished.wait(lock);
+      errorMessage = _errorMessage;
+      return _ok;
+    }
+
+    boost::mutex _mutex;
+    boost::condition_variable _finished;
+    bool _done;
+    bool _ok;
+    std::string _errorMessage;
+  };
+}
+
+bool SQLiteWriteQueue::execute(const std::string& statement, std::string& errorMessage) {
+  assert(boost::this_thread::get_id() != _thread->get_id());
+  Waiter w;
+  enqueue(statement,boost::bind(&Waiter::complete,&w,_1,_2));
+  return w.wait(errorMessage);
+}
+
+void SQLiteWriteQueue::flush() {
+  std::string ignored;
+  // statements are committed in order, so once a no-op is through, everything before it is too
+  execute("SELECT 1;",ignored);
+}
+
+SQLiteWriteQueue::Stats SQLiteWriteQueue::stats() const {
+  boost::mutex::scoped_lock lock(_mutex);
+  Stats s(_stats);
+  s.pending = _pending.size();
+  return s;
+}
+
+void SQLiteWriteQueue::setBatchCallback(const BatchCallback& callback) {
+  boost::mutex::scoped_lock lock(_mutex);
+  _batchCallback = callback;
+}
+
+void SQLiteWriteQueue::run() {
+  Writes batch;
+  while (true) {
+    {
+      boost::mutex::scoped_lock lock(_mutex);
+      while (_pending.empty() && !_stopping)
+	_wakeup.wait(lock);
+      if (_pending.empty())
+	return; // stopping and fully drained
+      // give more writes a chance to join this batch
+      const boost::system_time deadline(boost::get_system_time() + _maxLatency);
+      while (_pending.size() < _maxBatchSize && !_stopping) {
+	if (!_wakeup.timed_wait(lock,deadline))
+	  break;
+      }
+      const size_t batchSize(std::min(_pending.size(),_maxBatchSize));
+      batch.assign(_pending.begin(),_pending.begin()+batchSize);
+      _pending.erase(_pending.begin(),_pending.begin()+batchSize);
+    }
+    commit(batch);
+    batch.clear();
+  }
+}
+
+bool SQLiteWriteQueue::exec(const std::string& statement, std::string& errorMessage) {
+  char* errMsg = 0;
+  const int ret(sqlite3_exec(_db, statement.c_str(), 0, 0, &errMsg));
+  if (errMsg) {
+    errorMessage = errMsg;
+    sqlite3_free(errMsg);
+  }
+  return ret == SQLITE_OK;
+}
+
+void SQLiteWriteQueue::commit(Writes& batch) {
+  std::vector<std::pair<bool,std::string> > results(batch.size(),std::make_pair(false,std::string()));
+  std::string errMsg;
+  bool committed(exec("BEGIN IMMEDIATE;",errMsg));
+  if (committed) {
+    for (size_t i(0); i<batch.size(); ++i) {
+      std::string ignored;
+      exec("SAVEPOINT queued_write;",ignored);
+      results[i].first = exec(batch[i]._statement,results[i].second);
+      if (results[i].first)
+	exec("RELEASE queued_write;",ignored);
+      else
+	exec("ROLLBACK TO queued_write; RELEASE queued_write;",ignored);
+    }
+    committed = exec("COMMIT;",errMsg);
+    if (!committed) {
+      std::string ignored;
+      exec("ROLLBACK;",ignored);
+    }
+  }
+  if (!committed) {
+    for (size_t i(0); i<batch.size(); ++i)
+      results[i] = std::make_pair(false,errMsg);
+  }
+  BatchCallback batchCallback;
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    batchCallback = _batchCallback;
+  }
+  if (batchCallback)
+    batchCallback();
+
+  unsigned long failures(0);
+  for (size_t i(0); i<batch.size(); ++i) {
+    if (!results[i].first)
+      ++failures;
+    if (batch[i]._callback)
+      batch[i]._callback(results[i].first,results[i].second);
+  }
+  boost::mutex::scoped_lock lock(_mutex);
+  ++_stats.batches;
+  _stats.statements += batch.size();
+  _stats.failures += failures;
+}
@@ -3,12 +3,22 @@
 
 SeasonsResourceHandler::SeasonsResourceHandler(const DBPtr db)
   : ResourceHandler(db,"seasons") { 
-  if (boost::dynamic_pointer_cast<SQLiteDB>(db)) {
+  const boost::shared_ptr<SQLiteDB> sqlite(boost::dynamic_pointer_cast<SQLiteDB>(db));
+  if (sqlite) {
     std::string errMsg;
     if (!db->execute("create table if not exists seasons (season_id integer primary key asc autoincrement, season_number integer not null, season_coverurl text, tvshow_id integer not null, foreign key(tvshow_id) references tvshows(show_id), unique (season_number,tvshow_id));",errMsg)) {
       std::cerr << "Unable to initialize seasons table in cache db. Reason: " << errMsg << std::endl;
       exit(1);
     }
+    std::vector<SQLiteDB::Index> indexes;
+    // covering, and ordered the way seasons are nested into shows. numbers are
+    // looked up through the unique constraint's index
+    indexes.push_back(SQLiteDB::Index("seasons_by_tvshow","tvshow_id, season_number, season_coverurl"));
+    indexes.push_back(SQLiteDB::Index("seasons_by_coverurl","season_coverurl"));
+    if (!sqlite->ensureIndexes("seasons",indexes,errMsg)) {
+      std::cerr << "Unable to create indexes on seasons table in cache db. Reason: " << errMsg << std::endl;
+      exit(1);
+    }
   }
 }
 
@@ -25,29 +35,32 @@ SanitizedParams SeasonsResourceHandler::sanitizeQueryParams(const pion::net::HTT
   const pion::net::HTTPTypes::QueryParams::const_iterator end(dirtyParams.end());
   for (; it!=end; ++it) {
     std::string sanitizedKey;
+    SanitizedParam::Type type(SanitizedParam::Text);
     const std::string& key = it->first;
-    if (key == id)
+    if (key == id) {
       sanitizedKey = season_id;
-    else if (key == number)
+      type = SanitizedParam::Integer;
+    } else if (key == number) {
       sanitizedKey = season_number;
-    else if (key == coverUrl)
+      type = SanitizedParam::Integer;
+    } else if (key == coverUrl)
       sanitizedKey = season_coverurl;
-    else if (key == tvShow)
+    else if (key == tvShow) {
       sanitizedKey = tvshow_id;
-    else
+      type = SanitizedParam::Integer;
+    } else
       continue;
-    sq.insert(std::make_pair(sanitizedKey,it->second));
+    sq.insert(std::make_pair(sanitizedKey,SanitizedParam(it->second,type)));
   }
   return sq;
 }
 
 void SeasonsResourceHandler::initTestData() {
   if (boost::dynamic_pointer_cast<SQLiteDB>(db())) {
-    std::string errMsg;
-    db()->execute("insert into seasons(season_id,season_number,season_coverurl,tvshow_id) values (1,1,'http://getvideoartwork.com/gallery/main.php?g2_view=core.DownloadItem&g2_itemId=8131&g2_serialNumber=2',1);",errMsg);
-    db()->execute("insert into seasons(season_id,season_number,season_coverurl,tvshow_id) values (2,2,'http://getvideoartwork.com/gallery/main.php?g2_view=core.DownloadItem&g2_itemId=8131&g2_serialNumber=2',1);",errMsg);
-    db()->execute("insert into seasons(season_id,season_number,season_coverurl,tvshow_id) values (3,3,'http://getvideoartwork.com/gallery/main.php?g2_view=core.DownloadItem&g2_itemId=8131&g2_serialNumber=3',2);",errMsg);
-    db()->execute("insert into seasons(season_id,season_number,season_coverurl,tvshow_id) values (4,4,'http://getvideoartwork.com/gallery/main.php?g2_view=core.DownloadItem&g2_itemId=8131&g2_serialNumber=2',2);",errMsg);
+    db()->queueWrite("insert into seasons(season_id,season_number,season_coverurl,tvshow_id) values (1,1,'http://getvideoartwork.com/gallery/main.php?g2_view=core.DownloadItem&g2_itemId=8131&g2_serialNumber=2',1);");
+    db()->queueWrite("insert into seasons(season_id,season_number,season_coverurl,tvshow_id) values (2,2,'http://getvideoartwork.com/gallery/main.php?g2_view=core.DownloadItem&g2_itemId=8131&g2_serialNumber=2',1);");
+    db()->queueWrite("insert into seasons(season_id,season_number,season_coverurl,tvshow_id) values (3,3,'http://getvideoartwork.com/gallery/main.php?g2_view=core.DownloadItem&g2_itemId=8131&g2_serialNumber=3',2);");
+    db()->queueWrite("insert into seasons(season_id,season_number,season_coverurl,tvshow_id) values (4,4,'http://getvideoartwork.com/gallery/main.php?g2_view=core.DownloadItem&g2_itemId=8131&g2_serialNumber=2',2);");
   }
 }
 
@@ -59,4 +72,24 @@ std::string SeasonsResourceHandler::listStatement() const {
   return viewStatement() + ";";
 }
 
+// expand=episodes nests the episodes of every season. the episodes' own ids are renamed so that
+// the seasons' search params, which name them unqualified, apply to the joined episodes as well
+bool SeasonsResourceHandler::expansion(const std::string& expand, std::vector<Expansion>& levels) const {
+  if (expand != "episodes")
+    return false;
+  Expansion seasons;
+  seasons.statement = viewStatement();
+  seasons.order.keyColumn = season_id;
+  levels.push_back(seasons);
+  Expansion episodes;
+  episodes.member = "episodes";
+  episodes.parentKey = "season";
+  episodes.statement = "select episode_id as id, episode_name as name, episode_imdbid as imdbId, episode_number as number, episode_season_id as season, episode_tvshow_id as tvShow from seasons join (select episode_id, episode_name, episode_imdbid, episode_number, season_id as episode_season_id, tvshow_id as episode_tvshow_id from episodes) on episode_season_id = season_id";
+  episodes.order.groupColumns.push_back(season_id);
+  episodes.order.orderColumn = "episode_number";
+  episodes.order.keyColumn = "episode_id";
+  levels.push_back(episodes);
+  return true;
+}
+
 
@@ -0,0 +1,69 @@
+#include "StatusResourceHandler.h"
+#include "CatalogDB.h"
+
+StatusResourceHandler::StatusResourceHandler(const DBPtr db)
+  : ResourceHandler(db,"status") {
+}
+
+void StatusResourceHandler::handle(pion::net::HTTPRequestPtr& request, pion::net::TCPConnectionPtr& connection) {
+  // every object is filled in where it sits in the document, rather than copied in once done
+  json::Object doc;
+  json::Object& content = doc["content"];
+  if (const boost::shared_ptr<SQLiteDB> sqliteDB = boost::dynamic_pointer_cast<SQLiteDB>(db())) {
+    const SQLiteStatementCache::Stats stats(sqliteDB->statementCacheStats());
+    json::Object& statementCache = content["statementCache"];
+    statementCache["size"] = json::Number(stats.size);
+    statementCache["capacity"] = json::Number(stats.capacity);
+    statementCache["hits"] = json::Number(stats.hits);
+    statementCache["misses"] = json::Number(stats.misses);
+    const SQLiteWriteQueue::Stats writeStats(sqliteDB->writeQueueStats());
+    json::Object& writeQueue = content["writeQueue"];
+    writeQueue["pending"] = json::Number(writeStats.pending);
+    writeQueue["batches"] = json::Number(writeStats.batches);
+    writeQueue["statements"] = json::Number(writeStats.statements);
+    writeQueue["failures"] = json::Number(writeStats.failures);
+    if (const boost::shared_ptr<SQLitePoolDB> pool = boost::dynamic_pointer_cast<SQLitePoolDB>(sqliteDB))
+      content["readerConnections"] = json::Number(pool->readerCount());
+    if (const boost::shared_ptr<CatalogDB> catalogDB = boost::dynamic_pointer_cast<CatalogDB>(sqliteDB)) {
+      const CatalogDB::Stats catalogStats(catalogDB->catalogStats());
+      json::Object& catalog = content["catalog"];
+      catalog["tables"] = json::Number(catalogStats.tables);
+      catalog["rows"] = json::Number(catalogStats.rows);
+      catalog["hits"] = json::Number(catalogStats.hits);
+      catalog["misses"] = json::Number(catalogStats.misses);
+      catalog["refreshes"] = json::Number(catalogStats.refreshes);
+    }
+  }
+  if (responseCache()) {
+    const ResponseCache::Stats stats(responseCache()->stats());
+    json::Object& responses = content["responseCache"];
+    responses["size"] = json::Number(stats.size);
+    responses["capacity"] = json::Number(stats.capacity);
+    responses["entries"] = json::Number(stats.entries);
+    responses["variants"] = json::Number(stats.variants);
+    responses["hits"] = json::Number(stats.hits);
+    responses["misses"] = json::Number(stats.misses);
+  }
+  if (executor()) {
+    const DBExecutor::Stats stats(executor()->stats());
+    json::Object& dbExecutor = content["dbExecutor"];
+    dbExecutor["threads"] = json::Number(stats.threads);
+    dbExecutor["capacity"] = json::Number(stats.capacity);
+    dbExecutor["queued"] = json::Number(stats.queued);
+    dbExecutor["busy"] = json::Number(stats.busy);
+    dbExecutor["executed"] = json::Number(stats.executed);
+    dbExecutor["rejected"] = json::Number(stats.rejected);
+    // waits are reported in ms
+    dbExecutor["meanWait"] = json::Number(stats.executed ? stats.totalWait / 1000.0 / stats.executed : 0);
+    dbExecutor["maxWait"] = json::Number(stats.maxWait / 1000.0);
+  }
+  doc["error"] = json::Null();
+  writeJsonHttpResponse(
+			doc,
+			*pion::net::HTTPResponseWriter::create(
+							       connection,
+							       *request,
+							       boost::bind(&pion::net::TCPConnection::finish, connection)),
+			true,
+			prettyJsonRequested(request));
+}
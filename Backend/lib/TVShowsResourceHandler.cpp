@@ -3,12 +3,21 @@
 
 TVShowsResourceHandler::TVShowsResourceHandler(const DBPtr db)
   : ResourceHandler(db,"tvshows") {
-  if (boost::dynamic_pointer_cast<SQLiteDB>(db)) {
+  const boost::shared_ptr<SQLiteDB> sqlite(boost::dynamic_pointer_cast<SQLiteDB>(db));
+  if (sqlite) {
     std::string errMsg;
     if (!db->execute("create table if not exists tvshows (show_id integer primary key asc autoincrement, show_name text not null, show_imdbid text, show_coverurl text);", errMsg)) {
       std::cerr << "Unable to initialize tvshows table in cache db. Reason: " << errMsg << std::endl;
       exit(1);
     }
+    std::vector<SQLiteDB::Index> indexes;
+    indexes.push_back(SQLiteDB::Index("tvshows_by_name","show_name"));
+    indexes.push_back(SQLiteDB::Index("tvshows_by_imdbid","show_imdbid"));
+    indexes.push_back(SQLiteDB::Index("tvshows_by_coverurl","show_coverurl"));
+    if (!sqlite->ensureIndexes("tvshows",indexes,errMsg)) {
+      std::cerr << "Unable to create indexes on tvshows table in cache db. Reason: " << errMsg << std::endl;
+      exit(1);
+    }
   }
 }
 
@@ -25,10 +34,12 @@ SanitizedParams TVShowsResourceHandler::sanitizeQueryParams(const pion::net::HTT
   const pion::net::HTTPTypes::QueryParams::const_iterator end(dirtyParams.end());
   for (; it!=end; ++it) {
     std::string sanitizedKey;
+    SanitizedParam::Type type(SanitizedParam::Text);
     const std::string& key = it->first;
-    if (key == id)
+    if (key == id) {
       sanitizedKey = show_id;
-    else if (key == coverUrl)
+      type = SanitizedParam::Integer;
+    } else if (key == coverUrl)
       sanitizedKey = show_coverurl;
     else if (key == name)
       sanitizedKey = show_name;
@@ -36,7 +47,7 @@ SanitizedParams TVShowsResourceHandler::sanitizeQueryParams(const pion::net::HTT
       sanitizedKey = show_imdbid;
     else
       continue;
-    sq.insert(std::make_pair(sanitizedKey,it->second));
+    sq.insert(std::make_pair(sanitizedKey,SanitizedParam(it->second,type)));
   }
   return sq;
 }
@@ -50,11 +61,43 @@ std::string TVShowsResourceHandler::listStatement() const {
   return viewStatement() + ";";
 }
 
+// expand=seasons nests the seasons of every show, expand=seasons.episodes their episodes as well.
+// the seasons and episodes are joined with the shows so that the shows' search params apply to them
+bool TVShowsResourceHandler::expansion(const std::string& expand, std::vector<Expansion>& levels) const {
+  const bool episodes(expand == "seasons.episodes");
+  if (!episodes && expand != "seasons")
+    return false;
+  Expansion shows;
+  shows.statement = viewStatement();
+  shows.order.keyColumn = show_id;
+  levels.push_back(shows);
+  Expansion seasons;
+  seasons.member = "seasons";
+  seasons.parentKey = "tvShow";
+  seasons.statement = "select season_id as id, season_number as number, season_coverurl as coverUrl, tvshow_id as tvShow from tvshows join seasons on tvshow_id = show_id";
+  seasons.order.groupColumns.push_back(show_id);
+  seasons.order.orderColumn = "season_number";
+  seasons.order.keyColumn = "season_id";
+  levels.push_back(seasons);
+  if (episodes) {
+    Expansion episodes;
+    episodes.member = "episodes";
+    episodes.parentKey = "season";
+    episodes.statement = "select episode_id as id, episode_name as name, episode_imdbid as imdbId, episode_number as number, episodes.season_id as season, episodes.tvshow_id as tvShow from tvshows join seasons on seasons.tvshow_id = show_id join episodes on episodes.season_id = seasons.season_id";
+    episodes.order.groupColumns.push_back(show_id);
+    episodes.order.groupColumns.push_back("season_number");
+    episodes.order.groupColumns.push_back("seasons.season_id");
+    episodes.order.orderColumn = "episode_number";
+    episodes.order.keyColumn = "episode_id";
+    levels.push_back(episodes);
+  }
+  return true;
+}
+
 
 void TVShowsResourceHandler::initTestData() {
   if (boost::dynamic_pointer_cast<SQLiteDB>(db())) {
-    std::string errMsg;
-    db()->execute("insert into tvshows (show_id,show_name,show_imdbid,show_coverurl) values (1, 'Desperate Housewives', 'tt0410975', 'http://getvideoartwork.com/gallery/main.php?g2_view=core.DownloadItem&g2_itemId=8131&g2_serialNumber=2');",errMsg);
-    db()->execute("insert into tvshows (show_id,show_name,show_imdbid,show_coverurl) values (2, 'Sex and the City', 'tt0159206', 'http://getvideoartwork.com/gallery/main.php?g2_view=core.DownloadItem&g2_itemId=70729&g2_serialNumber=1');",errMsg);
+    db()->queueWrite("insert into tvshows (show_id,show_name,show_imdbid,show_coverurl) values (1, 'Desperate Housewives', 'tt0410975', 'http://getvideoartwork.com/gallery/main.php?g2_view=core.DownloadItem&g2_itemId=8131&g2_serialNumber=2');");
+    db()->queueWrite("insert into tvshows (show_id,show_name,show_imdbid,show_coverurl) values (2, 'Sex and the City', 'tt0159206', 'http://getvideoartwork.com/gallery/main.php?g2_view=core.DownloadItem&g2_itemId=70729&g2_serialNumber=1');");
   }
 }
@@ -1,63 +1,202 @@
 #include "TestDB.h"
-#include <fstream>
+#include <json/reader.h>
+#include <boost/functional/hash.hpp>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  // steps over the rest of a value the parser has just begun
+  void skipValue(json::Parser& parser) {
+    const size_t depth(parser.Depth());
+    if (parser.Current() == json::Parser::EVENT_OBJECT_BEGIN || parser.Current() == json::Parser::EVENT_ARRAY_BEGIN) {
+      while (parser.Depth() >= depth)
+	parser.Next();
+    }
+  }
+
+  size_t hashValue(const char* value, const size_t size) {
+    return boost::hash_range(value,value+size);
+  }
+}
 
 TestDB::TestDB(const std::string& source, const bool createDoc)
-  : _doc(createDoc ? new json::Object : 0)
-  , _source(source) {
+  : _createDoc(createDoc)
+  , _source(source)
+  , _file(0)
+  , _fileSize(0) {
   if (createDoc && !source.empty()) {
     // try to load a doc with the same name as the source
-    std::ifstream sourceStream;
-    sourceStream.open((source + ".json").c_str(), std::ifstream::in);
-    if (sourceStream.is_open()) {
-      json::Reader::Read(*_doc,sourceStream);
+    map(source + ".json");
+    load();
+  }
+}
+
+TestDB::~TestDB() {
+  if (_file)
+    munmap(const_cast<char*>(_file),_fileSize);
+}
+
+void TestDB::map(const std::string& fileName) {
+  const int fd(open(fileName.c_str(),O_RDONLY));
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (fstat(fd,&st) == 0 && st.st_size > 0) {
+    void* const mapped(mmap(0,st.st_size,PROT_READ,MAP_PRIVATE,fd,0));
+    if (mapped != MAP_FAILED) {
+      _file = static_cast<const char*>(mapped);
+      _fileSize = st.st_size;
+    }
+  }
+  close(fd);
+}
+
+void TestDB::load() {
+  if (!_file)
+    return;
+  try {
+    json::Parser parser(_file,_file+_fileSize);
+    if (parser.Next() != json::Parser::EVENT_OBJECT_BEGIN) {
+      _loadError = _source + ".json is not a JSON object";
+      return;
     }
+    while (parser.Next() == json::Parser::EVENT_MEMBER_NAME) {
+      const bool content(parser.Value() == "content");
+      if (parser.Next() == json::Parser::EVENT_ARRAY_BEGIN && content)
+	loadItems(parser);
+      else
+	skipValue(parser);
+    }
+    parser.Next();
+  } catch (const json::Exception& e) {
+    _loadError = e.what();
+    _items.clear();
+    _members.clear();
+    _text.clear();
+    _keys.clear();
   }
 }
 
+// records where each item lies and the values of its string members, leaving nested values
+// to be read when the item is
+void TestDB::loadItems(json::Parser& parser) {
+  while (parser.Next() != json::Parser::EVENT_ARRAY_END) {
+    Item item;
+    item.begin = parser.TokenBeginOffset();
+    item.firstMember = _members.size();
+    if (parser.Current() == json::Parser::EVENT_OBJECT_BEGIN) {
+      while (parser.Next() == json::Parser::EVENT_MEMBER_NAME) {
+	const boost::uint32_t key(keyId(parser.Value()));
+	if (parser.Next() == json::Parser::EVENT_STRING) {
+	  Member member;
+	  member.key = key;
+	  member.size = parser.Value().size();
+	  member.offset = _text.size();
+	  _text += parser.Value();
+	  _members.push_back(member);
+	} else {
+	  skipValue(parser);
+	}
+      }
+    } else {
+      skipValue(parser);
+    }
+    item.end = parser.TokenEndOffset();
+    _items.push_back(item);
+  }
+}
+
+boost::uint32_t TestDB::keyId(const std::string& key) {
+  const std::map<std::string,boost::uint32_t>::const_iterator it(_keys.find(key));
+  if (it != _keys.end())
+    return it->second;
+  const boost::uint32_t id(_keys.size());
+  _keys[key] = id;
+  return id;
+}
+
+TestDB::IndexPtr TestDB::index(const boost::uint32_t key) const {
+  boost::mutex::scoped_lock lock(_mutex);
+  IndexPtr& index(_indexes[key]);
+  if (!index) {
+    const boost::shared_ptr<Index> built(new Index);
+    built->rehash(_items.size());
+    for (size_t i(0); i<_items.size(); ++i) {
+      const size_t end(i+1 < _items.size() ? _items[i+1].firstMember : _members.size());
+      for (size_t m(_items[i].firstMember); m<end; ++m) {
+	if (_members[m].key == key)
+	  built->insert(std::make_pair(hashValue(_text.data()+_members[m].offset,_members[m].size),i));
+      }
+    }
+    index = built;
+  }
+  return index;
+}
+
+// the whole document is only turned into elements if it's asked for
 JSONObjectPtr TestDB::doc() const {
+  boost::mutex::scoped_lock lock(_mutex);
+  if (!_doc && _createDoc) {
+    _doc.reset(new json::Object);
+    if (_file && _loadError.empty())
+      json::Reader::Read(*_doc,_file,_file+_fileSize);
+  }
   return _doc;
 }
 
 JSONObjectPtr TestDB::select(const std::string& fromSource) const {
-  if (fromSource == _source)
+  if (fromSource == _source && _loadError.empty())
     return doc();
   else {
     JSONObjectPtr resultsDoc(new json::Object);
-    (*resultsDoc)["error"] = json::String(std::string("unrecognized db source: ") + fromSource);
+    (*resultsDoc)["error"] = json::String(_loadError.empty() ? std::string("unrecognized db source: ") + fromSource : _loadError);
     return resultsDoc;
   }
 }
 
 JSONObjectPtr TestDB::selectWhere(const std::string& fromSource, const std::pair<const std::string,const std::string>& query) const {
   JSONObjectPtr resultsDoc(new json::Object);
-  bool errorSet(false);
-  json::Array resultsContent;
-  (*resultsDoc)["content"] = json::Array();
-  if (fromSource == _source) {
-    const std::string& key = query.first;
+  json::Array& resultsContent = (*resultsDoc)["content"];
+  std::string errorMessage;
+  const std::map<std::string,boost::uint32_t>::const_iterator key(_keys.find(query.first));
+  if (fromSource != _source)
+    errorMessage = std::string("unrecognized db source: ") + fromSource;
+  else if (!_loadError.empty())
+    errorMessage = _loadError;
+  else if (key == _keys.end()) {
+    if (!_items.empty())
+      errorMessage = "Object member not found: " + query.first;
+  } else {
     const std::string& value = query.second;
-    const json::Array& content = (*doc())["content"];
-    json::Array::const_iterator itemIt(content.Begin());
-    const json::Array::const_iterator end(content.End());
-    try {
-      for (; itemIt!=end; ++itemIt) {
-	const json::Object& item = *itemIt;
-	const json::String& itemValue = item[key];
-	if (itemValue == value)
-	  resultsContent.Insert(item);
+    const IndexPtr valueIndex(index(key->second));
+    std::vector<size_t> matches;
+    const std::pair<Index::const_iterator,Index::const_iterator> range(valueIndex->equal_range(hashValue(value.data(),value.size())));
+    for (Index::const_iterator it(range.first); it!=range.second; ++it) {
+      // the hashes of different values may collide
+      const size_t item(it->second);
+      const size_t end(item+1 < _items.size() ? _items[item+1].firstMember : _members.size());
+      for (size_t m(_items[item].firstMember); m<end; ++m) {
+	const Member& member(_members[m]);
+	if (member.key == key->second && value.compare(0,std::string::npos,_text,member.offset,member.size) == 0) {
+	  matches.push_back(item);
+	  break;
+	}
       }
-    } catch (const json::Exception& e) {
-      // probably the key is not part of the item object
-      (*resultsDoc)["error"] = json::String(e.what());
-      errorSet = true;
     }
-  } else {
-    (*resultsDoc)["error"] = json::String(std::string("unrecognized db source: ") + fromSource);
-    errorSet = true;
+    // in document order
+    std::sort(matches.begin(),matches.end());
+    matches.erase(std::unique(matches.begin(),matches.end()),matches.end());
+    for (std::vector<size_t>::const_iterator item(matches.begin()); item!=matches.end(); ++item) {
+      json::UnknownElement& element(*resultsContent.Insert(json::UnknownElement()));
+      json::Reader::Read(element,_file+_items[*item].begin,_file+_items[*item].end);
+    }
   }
-  (*resultsDoc)["content"] = resultsContent;
-  if (!errorSet)
+  if (errorMessage.empty())
     (*resultsDoc)["error"] = json::Null();
+  else
+    (*resultsDoc)["error"] = json::String(errorMessage);
   return resultsDoc;
 }
-
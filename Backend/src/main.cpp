@@ -14,7 +14,37 @@ namespace {
       ("help,h", "displays this help message")
       ("port,p", 
        po::value<size_t>(&o.port)->default_value(DEFAULT_PORT), 
-       "what port the backend should listen on");
+       "what port the backend should listen on")
+      ("scheduler",
+       po::value<std::string>(&o.scheduler)->default_value(DEFAULT_SCHEDULER),
+       "how requests are spread over the server threads: shared runs every thread on one queue, one-to-one gives each thread its own queue and hands out connections round robin and sharded also gives each thread its own listening socket on the port so that connections are accepted and handled on one thread")
+      ("threads",
+       po::value<size_t>(&o.threads)->default_value(SERVER_THREADS),
+       "number of threads handling requests, 0 runs one per core")
+      ("db-threads",
+       po::value<size_t>(&o.dbThreads)->default_value(DB_THREADS),
+       "number of threads running queries, so that a slow one doesn't hold up the connections of a request thread. 0 runs them on the request threads")
+      ("db-queue-size",
+       po::value<size_t>(&o.dbQueueSize)->default_value(DB_QUEUE_SIZE),
+       "number of requests that may wait for a db thread, more are answered with 503 Service Unavailable")
+      ("write-batch-size",
+       po::value<size_t>(&o.writeBatchSize)->default_value(WRITE_BATCH_SIZE),
+       "maximum number of db writes committed in a single transaction")
+      ("write-batch-latency",
+       po::value<size_t>(&o.writeBatchLatency)->default_value(WRITE_BATCH_LATENCY),
+       "maximum time in ms a db write waits for others to share its transaction")
+      ("chunk-size",
+       po::value<size_t>(&o.chunkSize)->default_value(RESPONSE_CHUNK_SIZE),
+       "responses larger than this many bytes are streamed in chunks of about this size, 0 disables chunking")
+      ("response-cache-size",
+       po::value<size_t>(&o.responseCacheSize)->default_value(RESPONSE_CACHE_SIZE),
+       "bytes of serialized responses kept to answer repeated queries with, 0 disables the cache")
+      ("compression-level",
+       po::value<int>(&o.compressionLevel)->default_value(COMPRESSION_LEVEL),
+       "how hard responses are compressed for clients that accept gzip or deflate, from 1 to 9, 0 disables compression")
+      ("check-query-plans",
+       po::bool_switch(&o.checkQueryPlans),
+       "checks that every search param is looked up and paged through with an index and exits, with status 1 if one isn't");
     po::variables_map vm;
     po::store(
 	      po::parse_command_line(
@@ -27,12 +57,26 @@ namespace {
       std::cout << od << std::endl;
       exit(1);
     }
+    if (o.scheduler != "shared" && o.scheduler != "one-to-one" && o.scheduler != "sharded") {
+      std::cerr << "scheduler must be shared, one-to-one or sharded" << std::endl;
+      exit(1);
+    }
+    if (o.dbThreads && !o.dbQueueSize) {
+      std::cerr << "db-queue-size must be at least 1" << std::endl;
+      exit(1);
+    }
+    if (o.compressionLevel < 0 || o.compressionLevel > 9) {
+      std::cerr << "compression-level must be between 0 and 9" << std::endl;
+      exit(1);
+    }
     return o;
   }
 
   void startServices(const Options& o) {
     try {
       FrontendServer fs(o);
+      if (o.checkQueryPlans)
+	exit(fs.checkQueryPlans() ? 0 : 1);
       fs.run();
     } catch (const std::exception& e) {
       std::cerr << "Caught exception running backend services: " << e.what() << std::endl;
@@ -0,0 +1,124 @@
+// benchmark.cpp : times json::Object member lookup against the std::list representation it
+//  replaced, on objects of growing size and on a TestDB-style filter over many small objects.
+//
+
+
+#include "json/elements.h"
+
+#include <ctime>
+#include <iostream>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+// the previous representation: members in a list, found by walking it
+class ListObject
+{
+public:
+   typedef std::list<json::Object::Member> Members;
+
+   json::UnknownElement& operator [](const std::string& name)
+   {
+      Members::iterator it = Find(name);
+      if (it == m_Members.end())
+         it = m_Members.insert(m_Members.end(), json::Object::Member(name));
+      return it->element;
+   }
+
+   Members::iterator Find(const std::string& name)
+   {
+      Members::iterator it = m_Members.begin();
+      while (it != m_Members.end() && it->name != name)
+         ++it;
+      return it;
+   }
+
+private:
+   Members m_Members;
+};
+
+
+std::vector<std::string> MemberNames(size_t nMembers)
+{
+   std::vector<std::string> names;
+   for (size_t i = 0; i < nMembers; ++i)
+   {
+      std::ostringstream name;
+      name << "member" << i;
+      names.push_back(name.str());
+   }
+   return names;
+}
+
+double Seconds(clock_t start)
+{
+   return double(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// builds an object of the given names, then looks every name up repeatedly
+template <typename ObjectT>
+double TimeLookups(const std::vector<std::string>& names, size_t nLookups, double& dSum)
+{
+   ObjectT object;
+   for (size_t i = 0; i < names.size(); ++i)
+      object[names[i]] = json::Number(double(i));
+
+   clock_t start = clock();
+   for (size_t i = 0; i < nLookups; ++i)
+   {
+      const json::Number& number = object[names[(i * 7919) % names.size()]];
+      dSum += number.Value();
+   }
+   return Seconds(start);
+}
+
+// many items of a few members each, filtered on their last member like TestDB::selectWhere
+template <typename ObjectT>
+double TimeFilter(size_t nItems, size_t nMembers, size_t nPasses, size_t& nMatches)
+{
+   const std::vector<std::string> names = MemberNames(nMembers);
+   std::vector<ObjectT> items(nItems);
+   for (size_t i = 0; i < nItems; ++i)
+      for (size_t j = 0; j < nMembers; ++j)
+         items[i][names[j]] = json::Number(double(i % 10));
+
+   clock_t start = clock();
+   for (size_t nPass = 0; nPass < nPasses; ++nPass)
+      for (size_t i = 0; i < nItems; ++i)
+      {
+         const json::Number& number = items[i][names.back()];
+         if (number.Value() == 3)
+            ++nMatches;
+      }
+   return Seconds(start);
+}
+
+
+int main()
+{
+   const size_t nLookups = 2000000;
+   double dSum = 0;
+
+   std::cout << "lookups of " << nLookups << " random members" << std::endl;
+   std::cout << "members\tlist (s)\tobject (s)" << std::endl;
+   const size_t sizes[] = { 4, 8, 16, 64, 256, 1024 };
+   for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+   {
+      const std::vector<std::string> names = MemberNames(sizes[i]);
+      const double dList = TimeLookups<ListObject>(names, nLookups, dSum);
+      const double dObject = TimeLookups<json::Object>(names, nLookups, dSum);
+      std::cout << sizes[i] << '\t' << dList << '\t' << dObject << std::endl;
+   }
+
+   size_t nMatches = 0;
+   std::cout << std::endl << "filtering 20000 items of 6 members, 50 passes" << std::endl;
+   std::cout << "list (s)\tobject (s)" << std::endl;
+   const double dList = TimeFilter<ListObject>(20000, 6, 50, nMatches);
+   const double dObject = TimeFilter<json::Object>(20000, 6, 50, nMatches);
+   std::cout << dList << '\t' << dObject << std::endl;
+
+   // keeps the work from being optimized away
+   return dSum < 0 || nMatches == 0;
+}
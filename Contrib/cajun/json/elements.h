@@ -9,7 +9,7 @@ Author: Terry Caton
 #pragma once
 
 #include <deque>
-#include <list>
+#include <vector>
 #include <string>
 #include <stdexcept>
 
@@ -89,6 +89,15 @@ public:
 
    UnknownElement& operator = (const UnknownElement& unknown);
 
+   // exchanges the contents of two elements without copying either. this is the way to move
+   //  a subtree around, e.g. into an array or object, when rvalue references aren't available
+   void Swap(UnknownElement& unknown);
+
+#if __cplusplus >= 201103L
+   UnknownElement(UnknownElement&& unknown);
+   UnknownElement& operator = (UnknownElement&& unknown);
+#endif
+
    // implicit cast to actual element type. throws on failure
    operator const Object& () const;
    operator const Array& () const;
@@ -141,6 +150,9 @@ private:
    template <typename ElementTypeT>
    ElementTypeT& ConvertTo();
 
+   // nulls carry no state, so they all share one implementation instead of allocating their own
+   static Imp* NullImp();
+
    Imp* m_pImp;
 };
 
@@ -164,9 +176,14 @@ public:
    
    iterator Insert(const UnknownElement& element, iterator itWhere);
    iterator Insert(const UnknownElement& element);
+#if __cplusplus >= 201103L
+   iterator Insert(UnknownElement&& element, iterator itWhere);
+   iterator Insert(UnknownElement&& element);
+#endif
    iterator Erase(iterator itWhere);
    void Resize(size_t newSize);
    void Clear();
+   void Swap(Array& array);
 
    size_t Size() const;
    bool Empty() const;
@@ -183,7 +200,11 @@ private:
 
 /////////////////////////////////////////////////////////////////////////////////
 // Object - mimics std::map<std::string, UnknownElement>. The member value 
-//  contents are effectively heterogeneous thanks to the UnknownElement class
+//  contents are effectively heterogeneous thanks to the UnknownElement class.
+// Members are kept in insertion order in one contiguous vector. Small objects are
+//  searched linearly, bigger ones get a hash index from name to position. As with
+//  std::map, the names are keys: don't change one in place, erase and reinsert
+//  the member instead
 
 class Object
 {
@@ -193,11 +214,13 @@ public:
 
       bool operator == (const Member& member) const;
 
+      void Swap(Member& member);
+
       std::string name;
       UnknownElement element;
    };
 
-   typedef std::list<Member> Members; // map faster, but does not preserve order
+   typedef std::vector<Member> Members;
    typedef Members::iterator iterator;
    typedef Members::const_iterator const_iterator;
 
@@ -216,16 +239,30 @@ public:
 
    iterator Insert(const Member& member);
    iterator Insert(const Member& member, iterator itWhere);
+#if __cplusplus >= 201103L
+   iterator Insert(Member&& member);
+   iterator Insert(Member&& member, iterator itWhere);
+#endif
    iterator Erase(iterator itWhere);
    void Clear();
+   void Swap(Object& object);
 
    UnknownElement& operator [](const std::string& name);
    const UnknownElement& operator [](const std::string& name) const;
 
 private:
-   class Finder;
+   // objects with more members than this are indexed
+   static const size_t INDEX_THRESHOLD = 8;
+
+   size_t Position(const std::string& name) const;
+   iterator InsertAt(size_t nPosition);
+   void Grow();
+   void IndexMember(size_t nPosition);
+   void Reindex();
+   static size_t Hash(const std::string& name);
 
    Members m_Members;
+   std::vector<size_t> m_Index; // open addressing, slots hold member positions. empty for small objects
 };
 
 
@@ -247,6 +284,8 @@ public:
    DataTypeT& Value();
    const DataTypeT& Value() const;
 
+   void Swap(TrivialType_T<DataTypeT>& trivial);
+
    bool operator == (const TrivialType_T<DataTypeT>& trivial) const;
 
 private:
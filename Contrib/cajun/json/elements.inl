@@ -108,16 +108,26 @@ public:
 
 
 
-inline UnknownElement::UnknownElement() :                               m_pImp( new Imp_T<Null>( Null() ) ) {}
-inline UnknownElement::UnknownElement(const UnknownElement& unknown) :  m_pImp( unknown.m_pImp->Clone()) {}
+inline UnknownElement::Imp* UnknownElement::NullImp()
+{
+   static Imp_T<Null> s_Null = Null();
+   return &s_Null;
+}
+
+inline UnknownElement::UnknownElement() :                               m_pImp( NullImp() ) {}
+inline UnknownElement::UnknownElement(const UnknownElement& unknown) :  m_pImp( unknown.m_pImp == NullImp() ? NullImp() : unknown.m_pImp->Clone()) {}
 inline UnknownElement::UnknownElement(const Object& object) :           m_pImp( new Imp_T<Object>(object) ) {}
 inline UnknownElement::UnknownElement(const Array& array) :             m_pImp( new Imp_T<Array>(array) ) {}
 inline UnknownElement::UnknownElement(const Number& number) :           m_pImp( new Imp_T<Number>(number) ) {}
 inline UnknownElement::UnknownElement(const Boolean& boolean) :         m_pImp( new Imp_T<Boolean>(boolean) ) {}
 inline UnknownElement::UnknownElement(const String& string) :           m_pImp( new Imp_T<String>(string) ) {}
-inline UnknownElement::UnknownElement(const Null& null) :               m_pImp( new Imp_T<Null>(null) ) {}
+inline UnknownElement::UnknownElement(const Null& null) :               m_pImp( NullImp() ) {}
 
-inline UnknownElement::~UnknownElement()   { delete m_pImp; }
+inline UnknownElement::~UnknownElement()
+{
+   if (m_pImp != NullImp())
+      delete m_pImp;
+}
 
 inline UnknownElement::operator const Object& () const    { return CastTo<Object>(); }
 inline UnknownElement::operator const Array& () const     { return CastTo<Array>(); }
@@ -135,11 +145,28 @@ inline UnknownElement::operator Null& ()      { return ConvertTo<Null>(); }
 
 inline UnknownElement& UnknownElement::operator = (const UnknownElement& unknown) 
 {
-   delete m_pImp;
-   m_pImp = unknown.m_pImp->Clone();
+   // copy first, so that assigning an element one of its own children works
+   UnknownElement copy(unknown);
+   Swap(copy);
    return *this;
 }
 
+inline void UnknownElement::Swap(UnknownElement& unknown)
+{
+   std::swap(m_pImp, unknown.m_pImp);
+}
+
+#if __cplusplus >= 201103L
+inline UnknownElement::UnknownElement(UnknownElement&& unknown) :       m_pImp( NullImp() ) { Swap(unknown); }
+
+inline UnknownElement& UnknownElement::operator = (UnknownElement&& unknown)
+{
+   UnknownElement moved(static_cast<UnknownElement&&>(unknown));
+   Swap(moved);
+   return *this;
+}
+#endif
+
 inline UnknownElement& UnknownElement::operator[] (const std::string& key)
 {
    // the people want an object. make us one if we aren't already
@@ -189,7 +216,8 @@ ElementTypeT& UnknownElement::ConvertTo()
    if (castVisitor.m_pElement == 0)
    {
       // we're not the right type. fix it & try again
-      *this = ElementTypeT();
+      UnknownElement converted = ElementTypeT();
+      Swap(converted);
       m_pImp->Accept(castVisitor);
    }
 
@@ -221,17 +249,11 @@ inline bool Object::Member::operator == (const Member& member) const
           element == member.element;
 }
 
-class Object::Finder : public std::unary_function<Object::Member, bool>
+inline void Object::Member::Swap(Member& member)
 {
-public:
-   Finder(const std::string& name) : m_name(name) {}
-   bool operator () (const Object::Member& member) {
-      return member.name == m_name;
-   }
-
-private:
-   std::string m_name;
-};
+   name.swap(member.name);
+   element.Swap(member.element);
+}
 
 
 
@@ -245,12 +267,14 @@ inline bool Object::Empty() const { return m_Members.empty(); }
 
 inline Object::iterator Object::Find(const std::string& name) 
 {
-   return std::find_if(m_Members.begin(), m_Members.end(), Finder(name));
+   const size_t nPosition = Position(name);
+   return nPosition == std::string::npos ? End() : Begin() + nPosition;
 }
 
 inline Object::const_iterator Object::Find(const std::string& name) const 
 {
-   return std::find_if(m_Members.begin(), m_Members.end(), Finder(name));
+   const size_t nPosition = Position(name);
+   return nPosition == std::string::npos ? End() : Begin() + nPosition;
 }
 
 inline Object::iterator Object::Insert(const Member& member)
@@ -260,42 +284,75 @@ inline Object::iterator Object::Insert(const Member& member)
 
 inline Object::iterator Object::Insert(const Member& member, iterator itWhere)
 {
-   iterator it = Find(member.name);
-   if (it != m_Members.end())
+   if (Position(member.name) != std::string::npos)
       throw Exception("Object member already exists: " + member.name);
 
-   it = m_Members.insert(itWhere, member);
+   Member copy(member);
+   iterator it = InsertAt(itWhere - Begin());
+   it->Swap(copy);
+   IndexMember(it - Begin());
    return it;
 }
 
+#if __cplusplus >= 201103L
+inline Object::iterator Object::Insert(Member&& member)
+{
+   return Insert(static_cast<Member&&>(member), End());
+}
+
+inline Object::iterator Object::Insert(Member&& member, iterator itWhere)
+{
+   if (Position(member.name) != std::string::npos)
+      throw Exception("Object member already exists: " + member.name);
+
+   iterator it = InsertAt(itWhere - Begin());
+   it->Swap(member);
+   IndexMember(it - Begin());
+   return it;
+}
+#endif
+
 inline Object::iterator Object::Erase(iterator itWhere) 
 {
-   return m_Members.erase(itWhere);
+   // swap the member to the back rather than let the vector copy all those behind it
+   const size_t nPosition = itWhere - Begin();
+   for (size_t i = nPosition; i + 1 < m_Members.size(); ++i)
+      m_Members[i].Swap(m_Members[i + 1]);
+   m_Members.pop_back();
+   Reindex();
+   return Begin() + nPosition;
 }
 
 inline UnknownElement& Object::operator [](const std::string& name)
 {
-
-   iterator it = Find(name);
-   if (it == m_Members.end())
+   size_t nPosition = Position(name);
+   if (nPosition == std::string::npos)
    {
-      Member member(name);
-      it = Insert(member, End());
+      nPosition = m_Members.size();
+      InsertAt(nPosition)->name = name;
+      IndexMember(nPosition);
    }
-   return it->element;      
+   return m_Members[nPosition].element;
 }
 
 inline const UnknownElement& Object::operator [](const std::string& name) const 
 {
-   const_iterator it = Find(name);
-   if (it == End())
+   const size_t nPosition = Position(name);
+   if (nPosition == std::string::npos)
       throw Exception("Object member not found: " + name);
-   return it->element;
+   return m_Members[nPosition].element;
 }
 
 inline void Object::Clear() 
 {
    m_Members.clear(); 
+   m_Index.clear();
+}
+
+inline void Object::Swap(Object& object)
+{
+   m_Members.swap(object.m_Members);
+   m_Index.swap(object.m_Index);
 }
 
 inline bool Object::operator == (const Object& object) const 
@@ -303,6 +360,97 @@ inline bool Object::operator == (const Object& object) const
    return m_Members == object.m_Members;
 }
 
+inline size_t Object::Position(const std::string& name) const
+{
+   if (m_Index.empty())
+   {
+      for (size_t i = 0; i < m_Members.size(); ++i)
+         if (m_Members[i].name == name)
+            return i;
+      return std::string::npos;
+   }
+
+   const size_t nMask = m_Index.size() - 1;
+   for (size_t nSlot = Hash(name) & nMask; m_Index[nSlot] != std::string::npos; nSlot = (nSlot + 1) & nMask)
+      if (m_Members[m_Index[nSlot]].name == name)
+         return m_Index[nSlot];
+   return std::string::npos;
+}
+
+// makes room for an empty member at the given position and returns it. the members after it
+//  are swapped along instead of copied. the caller fills in the name, and has to index the new
+//  member unless it went to the back
+inline Object::iterator Object::InsertAt(size_t nPosition)
+{
+   Grow();
+   m_Members.push_back(Member());
+   for (size_t i = m_Members.size() - 1; i > nPosition; --i)
+      m_Members[i].Swap(m_Members[i - 1]);
+   return Begin() + nPosition;
+}
+
+// a vector reallocating would copy every member, and with it every subtree. growing it by hand
+//  lets them be swapped over instead
+inline void Object::Grow()
+{
+   if (m_Members.size() < m_Members.capacity())
+      return;
+   Members grown;
+   grown.reserve(m_Members.empty() ? 4 : m_Members.size() * 2);
+   grown.resize(m_Members.size());
+   for (size_t i = 0; i < m_Members.size(); ++i)
+      grown[i].Swap(m_Members[i]);
+   m_Members.swap(grown);
+}
+
+inline void Object::IndexMember(size_t nPosition)
+{
+   if (nPosition + 1 != m_Members.size() || m_Index.size() < m_Members.size() * 2)
+   {
+      Reindex();
+      return;
+   }
+   const size_t nMask = m_Index.size() - 1;
+   size_t nSlot = Hash(m_Members[nPosition].name) & nMask;
+   while (m_Index[nSlot] != std::string::npos)
+      nSlot = (nSlot + 1) & nMask;
+   m_Index[nSlot] = nPosition;
+}
+
+inline void Object::Reindex()
+{
+   if (m_Members.size() <= INDEX_THRESHOLD)
+   {
+      std::vector<size_t>().swap(m_Index);
+      return;
+   }
+   // at most half full, so probe sequences stay short
+   size_t nSlots = 32;
+   while (nSlots < m_Members.size() * 4)
+      nSlots *= 2;
+   m_Index.assign(nSlots, std::string::npos);
+   const size_t nMask = nSlots - 1;
+   for (size_t i = 0; i < m_Members.size(); ++i)
+   {
+      size_t nSlot = Hash(m_Members[i].name) & nMask;
+      while (m_Index[nSlot] != std::string::npos)
+         nSlot = (nSlot + 1) & nMask;
+      m_Index[nSlot] = i;
+   }
+}
+
+// FNV-1a
+inline size_t Object::Hash(const std::string& name)
+{
+   size_t nHash = static_cast<size_t>(2166136261u);
+   for (std::string::const_iterator it = name.begin(); it != name.end(); ++it)
+   {
+      nHash ^= static_cast<unsigned char>(*it);
+      nHash *= 16777619u;
+   }
+   return nHash;
+}
+
 
 /////////////////
 // Array members
@@ -322,6 +470,18 @@ inline Array::iterator Array::Insert(const UnknownElement& element)
    return Insert(element, End());
 }
 
+#if __cplusplus >= 201103L
+inline Array::iterator Array::Insert(UnknownElement&& element, iterator itWhere)
+{ 
+   return m_Elements.insert(itWhere, static_cast<UnknownElement&&>(element));
+}
+
+inline Array::iterator Array::Insert(UnknownElement&& element)
+{
+   return Insert(static_cast<UnknownElement&&>(element), End());
+}
+#endif
+
 inline Array::iterator Array::Erase(iterator itWhere)
 { 
    return m_Elements.erase(itWhere);
@@ -354,6 +514,11 @@ inline void Array::Clear() {
    m_Elements.clear();
 }
 
+inline void Array::Swap(Array& array)
+{
+   m_Elements.swap(array.m_Elements);
+}
+
 inline bool Array::operator == (const Array& array) const
 {
    return m_Elements == array.m_Elements;
@@ -391,6 +556,12 @@ const DataTypeT& TrivialType_T<DataTypeT>::Value() const
    return m_tValue; 
 }
 
+template <typename DataTypeT>
+void TrivialType_T<DataTypeT>::Swap(TrivialType_T<DataTypeT>& trivial)
+{
+   std::swap(m_tValue, trivial.m_tValue);
+}
+
 template <typename DataTypeT>
 bool TrivialType_T<DataTypeT>::operator == (const TrivialType_T<DataTypeT>& trivial) const
 {
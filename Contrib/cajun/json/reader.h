@@ -15,6 +15,8 @@ Author: Terry Caton
 namespace json
 {
 
+class Parser;
+
 class Reader
 {
 public:
@@ -28,7 +30,7 @@ public:
       unsigned int m_nDocOffset;  // character offset from entire document, zero indexed
    };
 
-   // thrown during the first phase of reading. generally catches low-level problems such
+   // thrown when reading the characters of a token. generally catches low-level problems such
    //  as errant characters or corrupt/incomplete documents
    class ScanException : public Exception
    {
@@ -40,7 +42,7 @@ public:
       Reader::Location m_locError;
    };
 
-   // thrown during the second phase of reading. generally catches higher-level problems such
+   // thrown when putting tokens together. generally catches higher-level problems such
    //  as missing commas or brackets
    class ParseException : public Exception
    {
@@ -66,56 +68,120 @@ public:
    // ...otherwise, if you don't know, call this & visit it
    static void Read(UnknownElement& elementRoot, std::istream& istr);
 
+   // the same, for documents already in memory
+   static void Read(Object& object, const char* pBegin, const char* pEnd);
+   static void Read(Array& array, const char* pBegin, const char* pEnd);
+   static void Read(UnknownElement& elementRoot, const char* pBegin, const char* pEnd);
+
 private:
-   struct Token
+   template <typename ElementTypeT>   
+   static void Read_i(ElementTypeT& element, std::istream& istr);
+
+   template <typename ElementTypeT>   
+   static void Read_i(ElementTypeT& element, const char* pBegin, const char* pEnd);
+
+   // building the element structure from the parser's events. each starts out with the
+   //  parser on the event that begins the value
+   void Parse(UnknownElement& element, Parser& parser);
+   void Parse(Object& object, Parser& parser);
+   void Parse(Array& array, Parser& parser);
+   void Parse(String& string, Parser& parser);
+   void Parse(Number& number, Parser& parser);
+   void Parse(Boolean& boolean, Parser& parser);
+   void Parse(Null& null, Parser& parser);
+
+   void ThrowUnexpectedEvent(const Parser& parser);
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////
+// Parser - reads a document straight out of a buffer and reports it piece by piece,
+//  in document order, without building any elements. Use it to pick what you need out
+//  of documents too big to hold as elements: call Next() until it returns EVENT_END,
+//  and Skip() over the values you aren't interested in. Memory use doesn't grow with
+//  the document, only with how deeply it nests. Errors are reported with the same
+//  exceptions Reader throws, as soon as they're reached.
+
+class Parser
+{
+public:
+   enum Event
    {
-      enum Type
-      {
-         TOKEN_OBJECT_BEGIN,  //    {
-         TOKEN_OBJECT_END,    //    }
-         TOKEN_ARRAY_BEGIN,   //    [
-         TOKEN_ARRAY_END,     //    ]
-         TOKEN_NEXT_ELEMENT,  //    ,
-         TOKEN_MEMBER_ASSIGN, //    :
-         TOKEN_STRING,        //    "xxx"
-         TOKEN_NUMBER,        //    [+/-]000.000[e[+/-]000]
-         TOKEN_BOOLEAN,       //    true -or- false
-         TOKEN_NULL           //    null
-      };
-
-      Type nType;
-      std::string sValue;
-
-      // for malformed file debugging
-      Reader::Location locBegin;
-      Reader::Location locEnd;
+      EVENT_OBJECT_BEGIN,  //    {
+      EVENT_OBJECT_END,    //    }
+      EVENT_ARRAY_BEGIN,   //    [
+      EVENT_ARRAY_END,     //    ]
+      EVENT_MEMBER_NAME,   //    "xxx" : (the member's value follows)
+      EVENT_STRING,        //    "xxx"
+      EVENT_NUMBER,        //    [+/-]000.000[e[+/-]000]
+      EVENT_BOOLEAN,       //    true -or- false
+      EVENT_NULL,          //    null
+      EVENT_END            //    the document is complete
    };
 
-   class InputStream;
-   class TokenStream;
-   typedef std::vector<Token> Tokens;
+   // the buffer has to stay around while it's being parsed
+   Parser(const char* pBegin, const char* pEnd);
 
-   template <typename ElementTypeT>   
-   static void Read_i(ElementTypeT& element, std::istream& istr);
+   Event Next();
+   Event Current() const;
+
+   // skips over the next value, nested values included
+   void Skip();
+
+   // the contents of the last string or member name, or the text of any other token
+   const std::string& Value() const;
+   double NumberValue() const;
+   bool BooleanValue() const;
+
+   // the number of objects and arrays currently open
+   size_t Depth() const;
+
+   // where the last token began and ended
+   Reader::Location TokenBegin() const;
+   Reader::Location TokenEnd() const;
+
+   // the same as offsets into the buffer, which are cheap to get. e.g. an object spans from
+   //  the begin offset of its EVENT_OBJECT_BEGIN to the end offset of its EVENT_OBJECT_END
+   size_t TokenBeginOffset() const;
+   size_t TokenEndOffset() const;
+
+private:
+   enum State
+   {
+      STATE_VALUE,               // a value is due
+      STATE_FIRST_VALUE,         // a value, or the end of the array just begun
+      STATE_MEMBER_NAME,         // a member name is due
+      STATE_FIRST_MEMBER_NAME,   // a member name, or the end of the object just begun
+      STATE_MEMBER_ASSIGN,       // the colon after a member name
+      STATE_NEXT,                // a comma, or the end of the enclosing object or array
+      STATE_DONE                 // nothing more but white space
+   };
+
+   char ScanToken();
+   void ScanString();
+   void ScanNumber();
+   void ScanExpectedString(const char* sExpected);
+   const char* ScanUnicodeEscape(const char* p);
+   unsigned int ScanHexDigits(const char* p);
+
+   Event BeginValue(char cToken);
+   Event EndContainer(char cToken);
+   void EndValue();
+   void ThrowUnexpectedToken(char cToken) const;
 
-   // scanning istream into token sequence
-   void Scan(Tokens& tokens, InputStream& inputStream);
+   Reader::Location LocationOf(const char* p) const;
 
-   void EatWhiteSpace(InputStream& inputStream);
-   void MatchString(std::string& sValue, InputStream& inputStream);
-   void MatchNumber(std::string& sNumber, InputStream& inputStream);
-   void MatchExpectedString(const std::string& sExpected, InputStream& inputStream);
+   const char* m_pBegin;
+   const char* m_pEnd;
+   const char* m_pCurrent;
+   const char* m_pTokenBegin;
 
-   // parsing token sequence into element structure
-   void Parse(UnknownElement& element, TokenStream& tokenStream);
-   void Parse(Object& object, TokenStream& tokenStream);
-   void Parse(Array& array, TokenStream& tokenStream);
-   void Parse(String& string, TokenStream& tokenStream);
-   void Parse(Number& number, TokenStream& tokenStream);
-   void Parse(Boolean& boolean, TokenStream& tokenStream);
-   void Parse(Null& null, TokenStream& tokenStream);
+   Event m_nEvent;
+   State m_nState;
+   std::vector<char> m_Containers; // the opening bracket of each one open
 
-   const std::string& MatchExpectedToken(Token::Type nExpected, TokenStream& tokenStream);
+   std::string m_sValue;
+   double m_dValue;
 };
 
 
@@ -6,15 +6,12 @@ Author: Terry Caton
 
 ***********************************************/
 
-#include <cassert>
-#include <set>
-#include <sstream>
+#include <cstdlib>
 
-/*  
+/*
 
 TODO:
 * better documentation
-* unicode character decoding
 
 */
 
@@ -34,486 +31,541 @@ inline Reader::Location::Location() :
 {}
 
 
-//////////////////////
-// Reader::InputStream
+///////////////////
+// Parser members
+
+inline Parser::Parser(const char* pBegin, const char* pEnd) :
+   m_pBegin(pBegin),
+   m_pEnd(pEnd),
+   m_pCurrent(pBegin),
+   m_pTokenBegin(pBegin),
+   m_nEvent(EVENT_END),
+   m_nState(STATE_VALUE),
+   m_dValue(0)
+{}
 
-class Reader::InputStream // would be cool if we could inherit from std::istream & override "get"
+inline Parser::Event Parser::Next()
 {
-public:
-   InputStream(std::istream& iStr) :
-      m_iStr(iStr) {}
-
-   // protect access to the input stream, so we can keeep track of document/line offsets
-   char Get(); // big, define outside
-   char Peek() {
-      assert(m_iStr.eof() == false); // enforce reading of only valid stream data 
-      return m_iStr.peek();
-   }
-
-   bool EOS() {
-      m_iStr.peek(); // apparently eof flag isn't set until a character read is attempted. whatever.
-      return m_iStr.eof();
-   }
-
-   const Location& GetLocation() const { return m_Location; }
-
-private:
-   std::istream& m_iStr;
-   Location m_Location;
-};
+   for (;;)
+   {
+      const char cToken = ScanToken();
+      switch (m_nState)
+      {
+         case STATE_VALUE:
+            return m_nEvent = BeginValue(cToken);
+
+         case STATE_FIRST_VALUE:
+            if (cToken == ']')
+               return m_nEvent = EndContainer(cToken);
+            return m_nEvent = BeginValue(cToken);
+
+         case STATE_FIRST_MEMBER_NAME:
+            if (cToken == '}')
+               return m_nEvent = EndContainer(cToken);
+            // fall through
+
+         case STATE_MEMBER_NAME:
+            if (cToken != '"')
+               ThrowUnexpectedToken(cToken);
+            m_nState = STATE_MEMBER_ASSIGN;
+            return m_nEvent = EVENT_MEMBER_NAME;
+
+         case STATE_MEMBER_ASSIGN:
+            if (cToken != ':')
+               ThrowUnexpectedToken(cToken);
+            m_nState = STATE_VALUE;
+            break;
 
+         case STATE_NEXT:
+            if (cToken != ',')
+               return m_nEvent = EndContainer(cToken);
+            m_nState = (m_Containers.back() == '{' ? STATE_MEMBER_NAME : STATE_VALUE);
+            break;
 
-inline char Reader::InputStream::Get()
-{
-   assert(m_iStr.eof() == false); // enforce reading of only valid stream data 
-   char c = m_iStr.get();
-   
-   ++m_Location.m_nDocOffset;
-   if (c == '\n') {
-      ++m_Location.m_nLine;
-      m_Location.m_nLineOffset = 0;
-   }
-   else {
-      ++m_Location.m_nLineOffset;
+         case STATE_DONE:
+            if (cToken != '\0')
+            {
+               std::string sMessage = "Expected End of token stream; found " + m_sValue;
+               throw Reader::ParseException(sMessage, TokenBegin(), TokenEnd());
+            }
+            return m_nEvent = EVENT_END;
+      }
    }
-
-   return c;
 }
 
-
-
-//////////////////////
-// Reader::TokenStream
-
-class Reader::TokenStream
+inline Parser::Event Parser::Current() const
 {
-public:
-   TokenStream(const Tokens& tokens);
+   return m_nEvent;
+}
 
-   const Token& Peek();
-   const Token& Get();
+inline void Parser::Skip()
+{
+   const size_t nDepth = m_Containers.size();
+   Next();
+   while (m_Containers.size() > nDepth)
+      Next();
+}
 
-   bool EOS() const;
+inline const std::string& Parser::Value() const   { return m_sValue; }
+inline double Parser::NumberValue() const         { return m_dValue; }
+inline bool Parser::BooleanValue() const          { return m_sValue == "true"; }
+inline size_t Parser::Depth() const               { return m_Containers.size(); }
 
-private:
-   const Tokens& m_Tokens;
-   Tokens::const_iterator m_itCurrent;
-};
+inline Reader::Location Parser::TokenBegin() const   { return LocationOf(m_pTokenBegin); }
+inline Reader::Location Parser::TokenEnd() const     { return LocationOf(m_pCurrent); }
+inline size_t Parser::TokenBeginOffset() const       { return m_pTokenBegin - m_pBegin; }
+inline size_t Parser::TokenEndOffset() const         { return m_pCurrent - m_pBegin; }
 
 
-inline Reader::TokenStream::TokenStream(const Tokens& tokens) :
-   m_Tokens(tokens),
-   m_itCurrent(tokens.begin())
-{}
+inline Parser::Event Parser::BeginValue(char cToken)
+{
+   switch (cToken)
+   {
+      case '{':
+         m_Containers.push_back(cToken);
+         m_nState = STATE_FIRST_MEMBER_NAME;
+         return EVENT_OBJECT_BEGIN;
+
+      case '[':
+         m_Containers.push_back(cToken);
+         m_nState = STATE_FIRST_VALUE;
+         return EVENT_ARRAY_BEGIN;
+
+      case '"':   EndValue();  return EVENT_STRING;
+      case '0':   EndValue();  return EVENT_NUMBER;
+      case 't':
+      case 'f':   EndValue();  return EVENT_BOOLEAN;
+      case 'n':   EndValue();  return EVENT_NULL;
 
-inline const Reader::Token& Reader::TokenStream::Peek() {
-   assert(m_itCurrent != m_Tokens.end());
-   return *(m_itCurrent); 
+      default:
+         ThrowUnexpectedToken(cToken);
+         return EVENT_END;
+   }
 }
 
-inline const Reader::Token& Reader::TokenStream::Get() {
-   assert(m_itCurrent != m_Tokens.end());
-   return *(m_itCurrent++); 
+inline Parser::Event Parser::EndContainer(char cToken)
+{
+   const char cOpen = (cToken == '}' ? '{' : '[');
+   if ((cToken != '}' && cToken != ']') || m_Containers.back() != cOpen)
+      ThrowUnexpectedToken(cToken);
+   m_Containers.pop_back();
+   EndValue();
+   return cToken == '}' ? EVENT_OBJECT_END : EVENT_ARRAY_END;
 }
 
-inline bool Reader::TokenStream::EOS() const {
-   return m_itCurrent == m_Tokens.end(); 
+inline void Parser::EndValue()
+{
+   m_nState = (m_Containers.empty() ? STATE_DONE : STATE_NEXT);
 }
 
-///////////////////
-// Reader (finally)
-
+inline void Parser::ThrowUnexpectedToken(char cToken) const
+{
+   if (cToken == '\0')
+   {
+      std::string sMessage = "Unexpected End of token stream";
+      throw Reader::ParseException(sMessage, Reader::Location(), Reader::Location()); // nowhere to point to
+   }
+   std::string sMessage = "Unexpected token: " + m_sValue;
+   throw Reader::ParseException(sMessage, TokenBegin(), TokenEnd());
+}
 
-inline void Reader::Read(Object& object, std::istream& istr)                { Read_i(object, istr); }
-inline void Reader::Read(Array& array, std::istream& istr)                  { Read_i(array, istr); }
-inline void Reader::Read(String& string, std::istream& istr)                { Read_i(string, istr); }
-inline void Reader::Read(Number& number, std::istream& istr)                { Read_i(number, istr); }
-inline void Reader::Read(Boolean& boolean, std::istream& istr)              { Read_i(boolean, istr); }
-inline void Reader::Read(Null& null, std::istream& istr)                    { Read_i(null, istr); }
-inline void Reader::Read(UnknownElement& unknown, std::istream& istr)       { Read_i(unknown, istr); }
+// locations are only needed for errors, so they're counted out when asked for instead of
+//  being kept up to date character by character
+inline Reader::Location Parser::LocationOf(const char* p) const
+{
+   Reader::Location location;
+   location.m_nDocOffset = static_cast<unsigned int>(p - m_pBegin);
+   for (const char* pLine = m_pBegin; pLine != p; ++pLine)
+   {
+      if (*pLine == '\n') {
+         ++location.m_nLine;
+         location.m_nLineOffset = 0;
+      }
+      else {
+         ++location.m_nLineOffset;
+      }
+   }
+   return location;
+}
 
 
-template <typename ElementTypeT>   
-void Reader::Read_i(ElementTypeT& element, std::istream& istr)
+// reads the next token, and returns its first character. numbers all come back as '0',
+//  and the end of the document as '\0'
+inline char Parser::ScanToken()
 {
-   Reader reader;
-
-   Tokens tokens;
-   InputStream inputStream(istr);
-   reader.Scan(tokens, inputStream);
+   // the same white space as isspace() in the "C" locale
+   while (m_pCurrent != m_pEnd && (*m_pCurrent == ' ' || (*m_pCurrent >= '\t' && *m_pCurrent <= '\r')))
+      ++m_pCurrent;
 
-   TokenStream tokenStream(tokens);
-   reader.Parse(element, tokenStream);
+   m_pTokenBegin = m_pCurrent;
+   if (m_pCurrent == m_pEnd)
+   {
+      m_sValue.clear();
+      return '\0';
+   }
 
-   if (tokenStream.EOS() == false)
+   const char c = *m_pCurrent;
+   switch (c)
    {
-      const Token& token = tokenStream.Peek();
-      std::string sMessage = "Expected End of token stream; found " + token.sValue;
-      throw ParseException(sMessage, token.locBegin, token.locEnd);
+      case '{':
+      case '}':
+      case '[':
+      case ']':
+      case ',':
+      case ':':
+         m_sValue.assign(1, c);
+         ++m_pCurrent;
+         return c;
+
+      case '"':
+         ScanString();
+         return c;
+
+      case '-':
+      case '0':
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9':
+         ScanNumber();
+         return '0';
+
+      case 't':   ScanExpectedString("true");   return c;
+      case 'f':   ScanExpectedString("false");  return c;
+      case 'n':   ScanExpectedString("null");   return c;
+
+      default: {
+         std::string sErrorMessage = "Unexpected character in stream: " + std::string(1, c);
+         throw Reader::ScanException(sErrorMessage, LocationOf(m_pCurrent));
+      }
    }
 }
 
-
-inline void Reader::Scan(Tokens& tokens, InputStream& inputStream)
+inline void Parser::ScanExpectedString(const char* sExpected)
 {
-   while (EatWhiteSpace(inputStream),              // ignore any leading white space...
-          inputStream.EOS() == false) // ...before checking for EOS
+   for (const char* pExpected = sExpected; *pExpected; ++pExpected, ++m_pCurrent)
    {
-      // if all goes well, we'll create a token each pass
-      Token token;
-      token.locBegin = inputStream.GetLocation();
-
-      // gives us null-terminated string
-      std::string sChar;
-      sChar.push_back(inputStream.Peek());
-
-      switch (sChar[0])
+      if (m_pCurrent == m_pEnd ||         // did we reach the end before finding what we're looking for...
+          *m_pCurrent != *pExpected)      // ...or did we find something different?
       {
-         case '{':
-            token.sValue = sChar[0];
-            MatchExpectedString(sChar, inputStream);
-            token.nType = Token::TOKEN_OBJECT_BEGIN;
-            break;
-
-         case '}':
-            token.sValue = sChar[0];
-            MatchExpectedString(sChar, inputStream);
-            token.nType = Token::TOKEN_OBJECT_END;
-            break;
-
-         case '[':
-            token.sValue = sChar[0];
-            MatchExpectedString(sChar, inputStream);
-            token.nType = Token::TOKEN_ARRAY_BEGIN;
-            break;
-
-         case ']':
-            token.sValue = sChar[0];
-            MatchExpectedString(sChar, inputStream);
-            token.nType = Token::TOKEN_ARRAY_END;
-            break;
-
-         case ',':
-            token.sValue = sChar[0];
-            MatchExpectedString(sChar, inputStream);
-            token.nType = Token::TOKEN_NEXT_ELEMENT;
-            break;
-
-         case ':':
-            token.sValue = sChar[0];
-            MatchExpectedString(sChar, inputStream);
-            token.nType = Token::TOKEN_MEMBER_ASSIGN;
-            break;
-
-         case '"':
-            MatchString(token.sValue, inputStream);
-            token.nType = Token::TOKEN_STRING;
-            break;
-
-         case '-':
-         case '0':
-         case '1':
-         case '2':
-         case '3':
-         case '4':
-         case '5':
-         case '6':
-         case '7':
-         case '8':
-         case '9':
-            MatchNumber(token.sValue, inputStream);
-            token.nType = Token::TOKEN_NUMBER;
-            break;
-
-         case 't':
-            token.sValue = "true";
-            MatchExpectedString(token.sValue, inputStream);
-            token.nType = Token::TOKEN_BOOLEAN;
-            break;
-
-         case 'f':
-            token.sValue = "false";
-            MatchExpectedString(token.sValue, inputStream);
-            token.nType = Token::TOKEN_BOOLEAN;
-            break;
+         std::string sMessage = "Expected string: " + std::string(sExpected);
+         throw Reader::ScanException(sMessage, LocationOf(m_pCurrent));
+      }
+   }
+   m_sValue.assign(sExpected);
+}
 
-         case 'n':
-            token.sValue = "null";
-            MatchExpectedString(token.sValue, inputStream);
-            token.nType = Token::TOKEN_NULL;
-            break;
+inline void Parser::ScanString()
+{
+   m_sValue.clear();
+   const char* p = m_pCurrent + 1;
+   for (;;)
+   {
+      // copy everything up to the next quote or escape in one go
+      const char* pRun = p;
+      while (p != m_pEnd && *p != '"' && *p != '\\')
+         ++p;
+      m_sValue.append(pRun, p);
+
+      if (p == m_pEnd || (*p == '\\' && p + 1 == m_pEnd))
+         throw Reader::ScanException("Expected string: \"", LocationOf(m_pEnd));
+      if (*p == '"')
+         break;
 
+      ++p;
+      switch (*p++) {
+         case '/':      m_sValue.push_back('/');     break;
+         case '"':      m_sValue.push_back('"');     break;
+         case '\\':     m_sValue.push_back('\\');    break;
+         case 'b':      m_sValue.push_back('\b');    break;
+         case 'f':      m_sValue.push_back('\f');    break;
+         case 'n':      m_sValue.push_back('\n');    break;
+         case 'r':      m_sValue.push_back('\r');    break;
+         case 't':      m_sValue.push_back('\t');    break;
+         case 'u':      p = ScanUnicodeEscape(p);    break;
          default: {
-            std::string sErrorMessage = "Unexpected character in stream: " + sChar;
-            throw ScanException(sErrorMessage, inputStream.GetLocation());
+            std::string sMessage = "Unrecognized escape sequence found in string: \\" + std::string(1, p[-1]);
+            throw Reader::ScanException(sMessage, LocationOf(p - 1));
          }
       }
-
-      token.locEnd = inputStream.GetLocation();
-      tokens.push_back(token);
    }
-}
 
+   // step over the closing quote
+   m_pCurrent = p + 1;
+}
 
-inline void Reader::EatWhiteSpace(InputStream& inputStream)
+// the four hex digits of a \u escape, with the \u already matched
+inline unsigned int Parser::ScanHexDigits(const char* p)
 {
-   while (inputStream.EOS() == false && 
-          ::isspace(inputStream.Peek()))
-      inputStream.Get();
+   unsigned int nValue = 0;
+   for (int i = 0; i < 4; ++i, ++p)
+   {
+      const char c = (p == m_pEnd ? '\0' : *p);
+      nValue <<= 4;
+      if (c >= '0' && c <= '9')        nValue |= c - '0';
+      else if (c >= 'a' && c <= 'f')   nValue |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')   nValue |= c - 'A' + 10;
+      else
+         throw Reader::ScanException("Malformed \\u escape sequence found in string", LocationOf(p));
+   }
+   return nValue;
 }
 
-inline void Reader::MatchExpectedString(const std::string& sExpected, InputStream& inputStream)
+// code points are stored UTF-8 encoded. those outside the basic plane come as a surrogate pair
+//  of escapes. returns the position after the escape
+inline const char* Parser::ScanUnicodeEscape(const char* p)
 {
-   std::string::const_iterator it(sExpected.begin()),
-                               itEnd(sExpected.end());
-   for ( ; it != itEnd; ++it) {
-      if (inputStream.EOS() ||      // did we reach the end before finding what we're looking for...
-          inputStream.Get() != *it) // ...or did we find something different?
-      {
-         std::string sMessage = "Expected string: " + sExpected;
-         throw ScanException(sMessage, inputStream.GetLocation());
-      }
+   unsigned int nCodePoint = ScanHexDigits(p);
+   p += 4;
+   if (nCodePoint >= 0xD800 && nCodePoint <= 0xDBFF)
+   {
+      if (m_pEnd - p < 2 || p[0] != '\\' || p[1] != 'u')
+         throw Reader::ScanException("Expected string: \\u", LocationOf(p));
+      const unsigned int nLow = ScanHexDigits(p + 2);
+      if (nLow < 0xDC00 || nLow > 0xDFFF)
+         throw Reader::ScanException("Unpaired surrogate found in string", LocationOf(p + 6));
+      nCodePoint = 0x10000 + ((nCodePoint - 0xD800) << 10) + (nLow - 0xDC00);
+      p += 6;
    }
 
-   // all's well if we made it here, return quietly
+   if (nCodePoint < 0x80)
+      m_sValue.push_back(static_cast<char>(nCodePoint));
+   else if (nCodePoint < 0x800)
+   {
+      m_sValue.push_back(static_cast<char>(0xC0 | (nCodePoint >> 6)));
+      m_sValue.push_back(static_cast<char>(0x80 | (nCodePoint & 0x3F)));
+   }
+   else if (nCodePoint < 0x10000)
+   {
+      m_sValue.push_back(static_cast<char>(0xE0 | (nCodePoint >> 12)));
+      m_sValue.push_back(static_cast<char>(0x80 | ((nCodePoint >> 6) & 0x3F)));
+      m_sValue.push_back(static_cast<char>(0x80 | (nCodePoint & 0x3F)));
+   }
+   else
+   {
+      m_sValue.push_back(static_cast<char>(0xF0 | (nCodePoint >> 18)));
+      m_sValue.push_back(static_cast<char>(0x80 | ((nCodePoint >> 12) & 0x3F)));
+      m_sValue.push_back(static_cast<char>(0x80 | ((nCodePoint >> 6) & 0x3F)));
+      m_sValue.push_back(static_cast<char>(0x80 | (nCodePoint & 0x3F)));
+   }
+   return p;
 }
 
-
-inline void Reader::MatchString(std::string& string, InputStream& inputStream)
+inline void Parser::ScanNumber()
 {
-   MatchExpectedString("\"", inputStream);
-   
-   while (inputStream.EOS() == false &&
-          inputStream.Peek() != '"')
+   const char* p = m_pCurrent;
+   while (p != m_pEnd &&
+          ((*p >= '0' && *p <= '9') || *p == '.' || *p == 'e' || *p == 'E' || *p == '-' || *p == '+'))
+      ++p;
+   m_sValue.assign(m_pCurrent, p);
+   m_pCurrent = p;
+
+   // integers short enough to be exact as doubles are common, and cheap to convert by hand
+   const bool bNegative = (m_sValue[0] == '-');
+   const size_t nDigits = m_sValue.size() - (bNegative ? 1 : 0);
+   if (nDigits > 0 && nDigits <= 15 && m_sValue.find_first_not_of("0123456789", bNegative ? 1 : 0) == std::string::npos)
    {
-      char c = inputStream.Get();
-
-      // escape?
-      if (c == '\\' &&
-          inputStream.EOS() == false) // shouldn't have reached the end yet
-      {
-         c = inputStream.Get();
-         switch (c) {
-            case '/':      string.push_back('/');     break;
-            case '"':      string.push_back('"');     break;
-            case '\\':     string.push_back('\\');    break;
-            case 'b':      string.push_back('\b');    break;
-            case 'f':      string.push_back('\f');    break;
-            case 'n':      string.push_back('\n');    break;
-            case 'r':      string.push_back('\r');    break;
-            case 't':      string.push_back('\t');    break;
-            case 'u':      // TODO: what do we do with this?
-            default: {
-               std::string sMessage = "Unrecognized escape sequence found in string: \\" + c;
-               throw ScanException(sMessage, inputStream.GetLocation());
-            }
-         }
-      }
-      else {
-         string.push_back(c);
-      }
+      long long nValue = 0;
+      for (size_t i = m_sValue.size() - nDigits; i < m_sValue.size(); ++i)
+         nValue = nValue * 10 + (m_sValue[i] - '0');
+      m_dValue = (bNegative ? -static_cast<double>(nValue) : static_cast<double>(nValue));
+      return;
    }
 
-   // eat the last '"' that we just peeked
-   MatchExpectedString("\"", inputStream);
+   // did the conversion consume all characters in the token?
+   char* pConverted = 0;
+   m_dValue = strtod(m_sValue.c_str(), &pConverted);
+   if (*pConverted != '\0')
+   {
+      std::string sMessage = "Unexpected character in NUMBER token: " + m_sValue;
+      throw Reader::ParseException(sMessage, TokenBegin(), TokenEnd());
+   }
 }
 
 
-inline void Reader::MatchNumber(std::string& sNumber, InputStream& inputStream)
-{
-   const char sNumericChars[] = "0123456789.eE-+";
-   std::set<char> numericChars;
-   numericChars.insert(sNumericChars, sNumericChars + sizeof(sNumericChars));
 
-   while (inputStream.EOS() == false &&
-          numericChars.find(inputStream.Peek()) != numericChars.end())
+///////////////////
+// Reader (finally)
+
+
+inline void Reader::Read(Object& object, std::istream& istr)                { Read_i(object, istr); }
+inline void Reader::Read(Array& array, std::istream& istr)                  { Read_i(array, istr); }
+inline void Reader::Read(String& string, std::istream& istr)                { Read_i(string, istr); }
+inline void Reader::Read(Number& number, std::istream& istr)                { Read_i(number, istr); }
+inline void Reader::Read(Boolean& boolean, std::istream& istr)              { Read_i(boolean, istr); }
+inline void Reader::Read(Null& null, std::istream& istr)                    { Read_i(null, istr); }
+inline void Reader::Read(UnknownElement& unknown, std::istream& istr)       { Read_i(unknown, istr); }
+
+inline void Reader::Read(Object& object, const char* pBegin, const char* pEnd)            { Read_i(object, pBegin, pEnd); }
+inline void Reader::Read(Array& array, const char* pBegin, const char* pEnd)              { Read_i(array, pBegin, pEnd); }
+inline void Reader::Read(UnknownElement& unknown, const char* pBegin, const char* pEnd)   { Read_i(unknown, pBegin, pEnd); }
+
+
+template <typename ElementTypeT>
+void Reader::Read_i(ElementTypeT& element, std::istream& istr)
+{
+   // the document is read in whole, straight from the stream's buffer, and parsed in a
+   //  single pass from there
+   std::string sDocument;
+   if (std::streambuf* pBuffer = istr.rdbuf())
    {
-      sNumber.push_back(inputStream.Get());   
+      char chunk[4096];
+      std::streamsize nRead;
+      while ((nRead = pBuffer->sgetn(chunk, sizeof(chunk))) > 0)
+         sDocument.append(chunk, static_cast<size_t>(nRead));
    }
+   istr.setstate(std::ios::eofbit);
+
+   Read_i(element, sDocument.data(), sDocument.data() + sDocument.size());
 }
 
 
-inline void Reader::Parse(UnknownElement& element, Reader::TokenStream& tokenStream) 
+template <typename ElementTypeT>
+void Reader::Read_i(ElementTypeT& element, const char* pBegin, const char* pEnd)
 {
-   if (tokenStream.EOS()) {
-      std::string sMessage = "Unexpected end of token stream";
-      throw ParseException(sMessage, Location(), Location()); // nowhere to point to
-   }
+   Parser parser(pBegin, pEnd);
+   parser.Next();
+
+   Reader reader;
+   reader.Parse(element, parser);
+
+   parser.Next(); // throws unless the document ends there
+}
+
 
-   const Token& token = tokenStream.Peek();
-   switch (token.nType) {
-      case Token::TOKEN_OBJECT_BEGIN:
+inline void Reader::Parse(UnknownElement& element, Parser& parser)
+{
+   switch (parser.Current()) {
+      case Parser::EVENT_OBJECT_BEGIN:
       {
          // implicit non-const cast will perform conversion for us (if necessary)
          Object& object = element;
-         Parse(object, tokenStream);
+         Parse(object, parser);
          break;
       }
 
-      case Token::TOKEN_ARRAY_BEGIN:
+      case Parser::EVENT_ARRAY_BEGIN:
       {
          Array& array = element;
-         Parse(array, tokenStream);
+         Parse(array, parser);
          break;
       }
 
-      case Token::TOKEN_STRING:
+      case Parser::EVENT_STRING:
       {
          String& string = element;
-         Parse(string, tokenStream);
+         Parse(string, parser);
          break;
       }
 
-      case Token::TOKEN_NUMBER:
+      case Parser::EVENT_NUMBER:
       {
          Number& number = element;
-         Parse(number, tokenStream);
+         Parse(number, parser);
          break;
       }
 
-      case Token::TOKEN_BOOLEAN:
+      case Parser::EVENT_BOOLEAN:
       {
          Boolean& boolean = element;
-         Parse(boolean, tokenStream);
+         Parse(boolean, parser);
          break;
       }
 
-      case Token::TOKEN_NULL:
+      case Parser::EVENT_NULL:
       {
          Null& null = element;
-         Parse(null, tokenStream);
+         Parse(null, parser);
          break;
       }
 
       default:
-      {
-         std::string sMessage = "Unexpected token: " + token.sValue;
-         throw ParseException(sMessage, token.locBegin, token.locEnd);
-      }
+         ThrowUnexpectedEvent(parser);
    }
 }
 
 
-inline void Reader::Parse(Object& object, Reader::TokenStream& tokenStream)
+inline void Reader::Parse(Object& object, Parser& parser)
 {
-   MatchExpectedToken(Token::TOKEN_OBJECT_BEGIN, tokenStream);
+   if (parser.Current() != Parser::EVENT_OBJECT_BEGIN)
+      ThrowUnexpectedEvent(parser);
 
-   bool bContinue = (tokenStream.EOS() == false &&
-                     tokenStream.Peek().nType != Token::TOKEN_OBJECT_END);
-   while (bContinue)
+   while (parser.Next() == Parser::EVENT_MEMBER_NAME)
    {
-      Object::Member member;
-
-      // first the member name. save the token in case we have to throw an exception
-      const Token& tokenName = tokenStream.Peek();
-      member.name = MatchExpectedToken(Token::TOKEN_STRING, tokenStream);
-
-      // ...then the key/value separator...
-      MatchExpectedToken(Token::TOKEN_MEMBER_ASSIGN, tokenStream);
-
-      // ...then the value itself (can be anything).
-      Parse(member.element, tokenStream);
-
-      // try adding it to the object (this could throw)
+      // add the member before its value, which is then parsed right into place
+      Object::iterator itMember;
       try
       {
-         object.Insert(member);
+         itMember = object.Insert(Object::Member(parser.Value()));
       }
       catch (Exception&)
       {
          // must be a duplicate name
-         std::string sMessage = "Duplicate object member token: " + member.name; 
-         throw ParseException(sMessage, tokenName.locBegin, tokenName.locEnd);
+         std::string sMessage = "Duplicate object member token: " + parser.Value();
+         throw ParseException(sMessage, parser.TokenBegin(), parser.TokenEnd());
       }
 
-      bContinue = (tokenStream.EOS() == false &&
-                   tokenStream.Peek().nType == Token::TOKEN_NEXT_ELEMENT);
-      if (bContinue)
-         MatchExpectedToken(Token::TOKEN_NEXT_ELEMENT, tokenStream);
+      parser.Next();
+      Parse(itMember->element, parser);
    }
-
-   MatchExpectedToken(Token::TOKEN_OBJECT_END, tokenStream);
 }
 
 
-inline void Reader::Parse(Array& array, Reader::TokenStream& tokenStream)
+inline void Reader::Parse(Array& array, Parser& parser)
 {
-   MatchExpectedToken(Token::TOKEN_ARRAY_BEGIN, tokenStream);
+   if (parser.Current() != Parser::EVENT_ARRAY_BEGIN)
+      ThrowUnexpectedEvent(parser);
 
-   bool bContinue = (tokenStream.EOS() == false &&
-                     tokenStream.Peek().nType != Token::TOKEN_ARRAY_END);
-   while (bContinue)
+   while (parser.Next() != Parser::EVENT_ARRAY_END)
    {
       // ...what's next? could be anything
       Array::iterator itElement = array.Insert(UnknownElement());
       UnknownElement& element = *itElement;
-      Parse(element, tokenStream);
-
-      bContinue = (tokenStream.EOS() == false &&
-                   tokenStream.Peek().nType == Token::TOKEN_NEXT_ELEMENT);
-      if (bContinue)
-         MatchExpectedToken(Token::TOKEN_NEXT_ELEMENT, tokenStream);
+      Parse(element, parser);
    }
-
-   MatchExpectedToken(Token::TOKEN_ARRAY_END, tokenStream);
 }
 
 
-inline void Reader::Parse(String& string, Reader::TokenStream& tokenStream)
+inline void Reader::Parse(String& string, Parser& parser)
 {
-   string = MatchExpectedToken(Token::TOKEN_STRING, tokenStream);
+   if (parser.Current() != Parser::EVENT_STRING)
+      ThrowUnexpectedEvent(parser);
+   string = parser.Value();
 }
 
 
-inline void Reader::Parse(Number& number, Reader::TokenStream& tokenStream)
+inline void Reader::Parse(Number& number, Parser& parser)
 {
-   const Token& currentToken = tokenStream.Peek(); // might need this later for throwing exception
-   const std::string& sValue = MatchExpectedToken(Token::TOKEN_NUMBER, tokenStream);
-
-   std::istringstream iStr(sValue);
-   double dValue;
-   iStr >> dValue;
-
-   // did we consume all characters in the token?
-   if (iStr.eof() == false)
-   {
-      std::string sMessage = "Unexpected character in NUMBER token: " + iStr.peek();
-      throw ParseException(sMessage, currentToken.locBegin, currentToken.locEnd);
-   }
-
-   number = dValue;
+   if (parser.Current() != Parser::EVENT_NUMBER)
+      ThrowUnexpectedEvent(parser);
+   number = parser.NumberValue();
 }
 
 
-inline void Reader::Parse(Boolean& boolean, Reader::TokenStream& tokenStream)
+inline void Reader::Parse(Boolean& boolean, Parser& parser)
 {
-   const std::string& sValue = MatchExpectedToken(Token::TOKEN_BOOLEAN, tokenStream);
-   boolean = (sValue == "true" ? true : false);
+   if (parser.Current() != Parser::EVENT_BOOLEAN)
+      ThrowUnexpectedEvent(parser);
+   boolean = parser.BooleanValue();
 }
 
 
-inline void Reader::Parse(Null&, Reader::TokenStream& tokenStream)
+inline void Reader::Parse(Null&, Parser& parser)
 {
-   MatchExpectedToken(Token::TOKEN_NULL, tokenStream);
+   if (parser.Current() != Parser::EVENT_NULL)
+      ThrowUnexpectedEvent(parser);
 }
 
 
-inline const std::string& Reader::MatchExpectedToken(Token::Type nExpected, Reader::TokenStream& tokenStream)
+inline void Reader::ThrowUnexpectedEvent(const Parser& parser)
 {
-   if (tokenStream.EOS())
-   {
-      std::string sMessage = "Unexpected End of token stream";
-      throw ParseException(sMessage, Location(), Location()); // nowhere to point to
-   }
-
-   const Token& token = tokenStream.Get();
-   if (token.nType != nExpected)
-   {
-      std::string sMessage = "Unexpected token: " + token.sValue;
-      throw ParseException(sMessage, token.locBegin, token.locEnd);
-   }
-
-   return token.sValue;
+   std::string sMessage = "Unexpected token: " + parser.Value();
+   throw ParseException(sMessage, parser.TokenBegin(), parser.TokenEnd());
 }
 
 } // End namespace
@@ -17,19 +17,48 @@ namespace json
 class Writer : private ConstVisitor
 {
 public:
-   static void Write(const Object& object, std::ostream& ostr);
-   static void Write(const Array& array, std::ostream& ostr);
-   static void Write(const String& string, std::ostream& ostr);
-   static void Write(const Number& number, std::ostream& ostr);
-   static void Write(const Boolean& boolean, std::ostream& ostr);
-   static void Write(const Null& null, std::ostream& ostr);
-   static void Write(const UnknownElement& elementRoot, std::ostream& ostr);
+   enum Format
+   {
+      FORMAT_PRETTY,    // one element per line, indented with tabs. easy on the eyes for debugging
+      FORMAT_COMPACT    // no insignificant whitespace at all
+   };
+
+   static void Write(const Object& object, std::ostream& ostr, Format format = FORMAT_PRETTY);
+   static void Write(const Array& array, std::ostream& ostr, Format format = FORMAT_PRETTY);
+   static void Write(const String& string, std::ostream& ostr, Format format = FORMAT_PRETTY);
+   static void Write(const Number& number, std::ostream& ostr, Format format = FORMAT_PRETTY);
+   static void Write(const Boolean& boolean, std::ostream& ostr, Format format = FORMAT_PRETTY);
+   static void Write(const Null& null, std::ostream& ostr, Format format = FORMAT_PRETTY);
+   static void Write(const UnknownElement& elementRoot, std::ostream& ostr, Format format = FORMAT_PRETTY);
+
+   // the document is appended to the buffer. a buffer that is cleared & reused keeps its memory, 
+   //  so once it has grown to fit, writing allocates nothing at all
+   static void Write(const Object& object, std::string& buffer, Format format = FORMAT_PRETTY);
+   static void Write(const Array& array, std::string& buffer, Format format = FORMAT_PRETTY);
+   static void Write(const String& string, std::string& buffer, Format format = FORMAT_PRETTY);
+   static void Write(const Number& number, std::string& buffer, Format format = FORMAT_PRETTY);
+   static void Write(const Boolean& boolean, std::string& buffer, Format format = FORMAT_PRETTY);
+   static void Write(const Null& null, std::string& buffer, Format format = FORMAT_PRETTY);
+   static void Write(const UnknownElement& elementRoot, std::string& buffer, Format format = FORMAT_PRETTY);
+
+   // writes the shortest text that reads back as the same double into digits, which must hold
+   //  NUMBER_DIGITS chars, & returns its length. nan & infinity are written as null
+   enum { NUMBER_DIGITS = 32 };
+   static size_t FormatNumber(double dValue, char* digits);
 
 private:
-   Writer(std::ostream& ostr);
+   Writer(std::string& buffer, Format format);
 
    template <typename ElementTypeT>
-   static void Write_i(const ElementTypeT& element, std::ostream& ostr);
+   static void Write_i(const ElementTypeT& element, std::ostream& ostr, Format format);
+
+   template <typename ElementTypeT>
+   static void Write_i(const ElementTypeT& element, std::string& buffer, Format format);
+
+   void WriteNewLine();
+   void WriteIndent();
+   void WriteString(const std::string& s);
+   static bool NeedsEscaping(const char* p);
 
    void Write_i(const Object& object);
    void Write_i(const Array& array);
@@ -46,7 +75,8 @@ private:
    virtual void Visit(const Boolean& boolean);
    virtual void Visit(const Null& null);
 
-   std::ostream& m_ostr;
+   std::string& m_sBuffer;
+   Format m_nFormat;
    int m_nTabDepth;
 };
 
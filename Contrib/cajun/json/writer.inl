@@ -7,8 +7,10 @@ Author: Terry Caton
 ***********************************************/
 
 #include "writer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <iomanip>
 
 /*  
 
@@ -22,118 +24,232 @@ namespace json
 {
 
 
-inline void Writer::Write(const UnknownElement& elementRoot, std::ostream& ostr) { Write_i(elementRoot, ostr); }
-inline void Writer::Write(const Object& object, std::ostream& ostr)              { Write_i(object, ostr); }
-inline void Writer::Write(const Array& array, std::ostream& ostr)                { Write_i(array, ostr); }
-inline void Writer::Write(const Number& number, std::ostream& ostr)              { Write_i(number, ostr); }
-inline void Writer::Write(const String& string, std::ostream& ostr)              { Write_i(string, ostr); }
-inline void Writer::Write(const Boolean& boolean, std::ostream& ostr)            { Write_i(boolean, ostr); }
-inline void Writer::Write(const Null& null, std::ostream& ostr)                  { Write_i(null, ostr); }
+inline void Writer::Write(const UnknownElement& elementRoot, std::ostream& ostr, Format format) { Write_i(elementRoot, ostr, format); }
+inline void Writer::Write(const Object& object, std::ostream& ostr, Format format)              { Write_i(object, ostr, format); }
+inline void Writer::Write(const Array& array, std::ostream& ostr, Format format)                { Write_i(array, ostr, format); }
+inline void Writer::Write(const Number& number, std::ostream& ostr, Format format)              { Write_i(number, ostr, format); }
+inline void Writer::Write(const String& string, std::ostream& ostr, Format format)              { Write_i(string, ostr, format); }
+inline void Writer::Write(const Boolean& boolean, std::ostream& ostr, Format format)            { Write_i(boolean, ostr, format); }
+inline void Writer::Write(const Null& null, std::ostream& ostr, Format format)                  { Write_i(null, ostr, format); }
 
+inline void Writer::Write(const UnknownElement& elementRoot, std::string& buffer, Format format) { Write_i(elementRoot, buffer, format); }
+inline void Writer::Write(const Object& object, std::string& buffer, Format format)              { Write_i(object, buffer, format); }
+inline void Writer::Write(const Array& array, std::string& buffer, Format format)                { Write_i(array, buffer, format); }
+inline void Writer::Write(const Number& number, std::string& buffer, Format format)              { Write_i(number, buffer, format); }
+inline void Writer::Write(const String& string, std::string& buffer, Format format)              { Write_i(string, buffer, format); }
+inline void Writer::Write(const Boolean& boolean, std::string& buffer, Format format)            { Write_i(boolean, buffer, format); }
+inline void Writer::Write(const Null& null, std::string& buffer, Format format)                  { Write_i(null, buffer, format); }
 
-inline Writer::Writer(std::ostream& ostr) :
-   m_ostr(ostr),
+
+inline Writer::Writer(std::string& buffer, Format format) :
+   m_sBuffer(buffer),
+   m_nFormat(format),
    m_nTabDepth(0)
 {}
 
+// streams get the document in one write once it has been put together in a buffer
 template <typename ElementTypeT>
-void Writer::Write_i(const ElementTypeT& element, std::ostream& ostr)
+void Writer::Write_i(const ElementTypeT& element, std::ostream& ostr, Format format)
 {
-   Writer writer(ostr);
-   writer.Write_i(element);
+   std::string buffer;
+   Write_i(element, buffer, format);
+   ostr.write(buffer.data(), buffer.size());
    ostr.flush(); // all done
 }
 
+template <typename ElementTypeT>
+void Writer::Write_i(const ElementTypeT& element, std::string& buffer, Format format)
+{
+   Writer writer(buffer, format);
+   writer.Write_i(element);
+}
+
+inline void Writer::WriteNewLine()
+{
+   if (m_nFormat == FORMAT_PRETTY)
+      m_sBuffer += '\n';
+}
+
+inline void Writer::WriteIndent()
+{
+   if (m_nFormat == FORMAT_PRETTY)
+      m_sBuffer.append(m_nTabDepth, '\t');
+}
+
 inline void Writer::Write_i(const Array& array)
 {
    if (array.Empty())
-      m_ostr << "[]";
+      m_sBuffer += "[]";
    else
    {
-      m_ostr << '[' << std::endl;
+      m_sBuffer += '[';
+      WriteNewLine();
       ++m_nTabDepth;
 
       Array::const_iterator it(array.Begin()),
                             itEnd(array.End());
       while (it != itEnd) {
-         m_ostr << std::string(m_nTabDepth, '\t');
+         WriteIndent();
          
          Write_i(*it);
 
          if (++it != itEnd)
-            m_ostr << ',';
-         m_ostr << std::endl;
+            m_sBuffer += ',';
+         WriteNewLine();
       }
 
       --m_nTabDepth;
-      m_ostr << std::string(m_nTabDepth, '\t') << ']';
+      WriteIndent();
+      m_sBuffer += ']';
    }
 }
 
 inline void Writer::Write_i(const Object& object)
 {
    if (object.Empty())
-      m_ostr << "{}";
+      m_sBuffer += "{}";
    else
    {
-      m_ostr << '{' << std::endl;
+      m_sBuffer += '{';
+      WriteNewLine();
       ++m_nTabDepth;
 
       Object::const_iterator it(object.Begin()),
                              itEnd(object.End());
       while (it != itEnd) {
-         m_ostr << std::string(m_nTabDepth, '\t') << '"' << it->name << "\" : ";
+         WriteIndent();
+         WriteString(it->name);
+         m_sBuffer += (m_nFormat == FORMAT_PRETTY ? " : " : ":");
          Write_i(it->element); 
 
          if (++it != itEnd)
-            m_ostr << ',';
-         m_ostr << std::endl;
+            m_sBuffer += ',';
+         WriteNewLine();
       }
 
       --m_nTabDepth;
-      m_ostr << std::string(m_nTabDepth, '\t') << '}';
+      WriteIndent();
+      m_sBuffer += '}';
+   }
+}
+
+// integral values, like most ids & counts, are written digit by digit. anything else gets the 
+//  fewest significant digits (15, 16 or 17) that still read back as exactly the same double
+inline size_t Writer::FormatNumber(double dValue, char* digits)
+{
+   if (dValue != dValue || dValue - dValue != 0)
+   {
+      std::memcpy(digits, "null", 4); // nan & infinity have no representation in JSON
+      return 4;
    }
+
+   if (dValue > -9007199254740992.0 && dValue < 9007199254740992.0 && dValue == static_cast<double>(static_cast<long long>(dValue)))
+   {
+      const long long nValue = static_cast<long long>(dValue);
+      unsigned long long nMagnitude = nValue < 0 ? -nValue : nValue;
+      char reversed[NUMBER_DIGITS];
+      char* p = reversed;
+      do {
+         *p++ = static_cast<char>('0' + nMagnitude % 10);
+         nMagnitude /= 10;
+      } while (nMagnitude);
+      if (nValue < 0)
+         *p++ = '-';
+      const size_t nLength = p - reversed;
+      for (size_t i = 0; i < nLength; ++i)
+         digits[i] = *--p;
+      return nLength;
+   }
+
+   int nLength = 0;
+   for (int nPrecision = 15; nPrecision <= 17; ++nPrecision)
+   {
+      nLength = std::sprintf(digits, "%.*g", nPrecision, dValue);
+      if (std::strtod(digits, 0) == dValue)
+         break;
+   }
+   return nLength;
 }
 
 inline void Writer::Write_i(const Number& numberElement)
 {
-   m_ostr << std::setprecision(20) << numberElement.Value();
+   char digits[NUMBER_DIGITS];
+   m_sBuffer.append(digits, FormatNumber(numberElement.Value(), digits));
 }
 
 inline void Writer::Write_i(const Boolean& booleanElement)
 {
-   m_ostr << (booleanElement.Value() ? "true" : "false");
+   m_sBuffer += (booleanElement.Value() ? "true" : "false");
 }
 
 inline void Writer::Write_i(const String& stringElement)
 {
-   m_ostr << '"';
+   WriteString(stringElement.Value());
+}
 
-   const std::string& s = stringElement.Value();
-   std::string::const_iterator it(s.begin()),
-                               itEnd(s.end());
-   for (; it != itEnd; ++it)
+// whether any of the sizeof(size_t) characters starting at p is a quote, a backslash or a 
+//  control character. checks them all at once with the usual "has zero/less than byte" tricks
+inline bool Writer::NeedsEscaping(const char* p)
+{
+   std::size_t word;
+   std::memcpy(&word, p, sizeof(word));
+   const std::size_t ones = ~std::size_t(0) / 255;
+   const std::size_t highs = ones * 0x80;
+   const std::size_t quotes = word ^ (ones * '"');
+   const std::size_t backslashes = word ^ (ones * '\\');
+   return (((quotes - ones) & ~quotes) | ((backslashes - ones) & ~backslashes) | ((word - ones * 0x20) & ~word)) & highs;
+}
+
+// runs of characters that need no escaping are found a word at a time & copied in one go
+inline void Writer::WriteString(const std::string& s)
+{
+   static const char hex[] = "0123456789abcdef";
+   m_sBuffer += '"';
+
+   const char* run = s.data();
+   const char* it = run;
+   const char* const itEnd = run + s.size();
+   while (it != itEnd)
    {
-      switch (*it)
+      while (static_cast<std::size_t>(itEnd - it) >= sizeof(std::size_t) && !NeedsEscaping(it))
+         it += sizeof(std::size_t);
+      if (it == itEnd)
+         break;
+
+      const unsigned char c = static_cast<unsigned char>(*it);
+      if (c >= 0x20 && c != '"' && c != '\\')
+      {
+         ++it;
+         continue;
+      }
+
+      m_sBuffer.append(run, it);
+      switch (c)
       {
-         case '"':         m_ostr << "\\\"";   break;
-         case '\\':        m_ostr << "\\\\";   break;
-         case '\b':        m_ostr << "\\b";    break;
-         case '\f':        m_ostr << "\\f";    break;
-         case '\n':        m_ostr << "\\n";    break;
-         case '\r':        m_ostr << "\\r";    break;
-         case '\t':        m_ostr << "\\t";    break;
-         //case '\u':        m_ostr << "";    break;  ??
-         default:          m_ostr << *it;       break;
+         case '"':         m_sBuffer += "\\\"";   break;
+         case '\\':        m_sBuffer += "\\\\";   break;
+         case '\b':        m_sBuffer += "\\b";    break;
+         case '\f':        m_sBuffer += "\\f";    break;
+         case '\n':        m_sBuffer += "\\n";    break;
+         case '\r':        m_sBuffer += "\\r";    break;
+         case '\t':        m_sBuffer += "\\t";    break;
+         default:
+         {
+            const char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+            m_sBuffer.append(escaped, 6);
+            break;
+         }
       }
+      run = ++it;
    }
+   m_sBuffer.append(run, itEnd);
 
-   m_ostr << '"';   
+   m_sBuffer += '"';   
 }
 
 inline void Writer::Write_i(const Null& )
 {
-   m_ostr << "null";
+   m_sBuffer += "null";
 }
 
 inline void Writer::Write_i(const UnknownElement& unknown)
@@ -177,6 +177,29 @@ int main()
    std::cout << "Original document and streamed document should be equivalent. operator == returned: "
       << (bEquals ? "true" : "false") << std::endl << std::endl;
 
+   // the compact format leaves out all the whitespace, but reads back just the same
+   std::stringstream streamCompact;
+   Writer::Write(objRoot, streamCompact, Writer::FORMAT_COMPACT);
+   std::cout << "Compact document: " << streamCompact.str() << std::endl;
+   Object elemRootCompact;
+   Reader::Read(elemRootCompact, streamCompact);
+   bool bEqualsCompact = (objRoot == elemRootCompact);
+   std::cout << "Original document and compact document should be equivalent. operator == returned: "
+      << (bEqualsCompact ? "true" : "false") << std::endl << std::endl;
+
+   // the parser reports a document piece by piece, without building any elements. here we
+   //  pull the beer names straight out of the compact document
+   const std::string sCompact = streamCompact.str();
+   Parser parser(sCompact.data(), sCompact.data() + sCompact.size());
+   std::cout << "Beer names pulled from the compact document:";
+   while (parser.Next() != Parser::EVENT_END)
+   {
+      if (parser.Current() == Parser::EVENT_MEMBER_NAME && parser.Value() == "Name" &&
+          parser.Next() == Parser::EVENT_STRING)
+         std::cout << " \"" << parser.Value() << '"';
+   }
+   std::cout << std::endl << std::endl;
+
 
    ////////////////////////////////////////////////////////////////////
    // document read error handling
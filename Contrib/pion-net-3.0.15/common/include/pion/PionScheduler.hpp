@@ -10,6 +10,7 @@
 #ifndef __PION_PIONSCHEDULER_HEADER__
 #define __PION_PIONSCHEDULER_HEADER__
 
+#include <deque>
 #include <vector>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
@@ -21,6 +22,8 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/xtime.hpp>
 #include <boost/thread/condition.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/detail/atomic_count.hpp>
 #include <pion/PionConfig.hpp>
 #include <pion/PionException.hpp>
 #include <pion/PionLogger.hpp>
@@ -80,6 +83,19 @@ public:
 	/// returns an async I/O service used to schedule work
 	virtual boost::asio::io_service& getIOService(void) = 0;
 	
+	/// returns the number of async I/O services that work is spread over
+	virtual boost::uint32_t getNumServices(void) const { return 1; }
+	
+	/**
+	 * returns a specific async I/O service used to schedule work
+	 *
+	 * @param n integer number representing the service object (less than getNumServices())
+	 */
+	virtual boost::asio::io_service& getIOService(boost::uint32_t n) {
+		PION_ASSERT(n < getNumServices());
+		return getIOService();
+	}
+	
 	/**
 	 * schedules work to be performed by one of the pooled threads
 	 *
@@ -309,6 +325,9 @@ public:
 		return m_service_pool[m_next_service]->first;
 	}
 	
+	/// returns the number of async I/O services that work is spread over
+	virtual boost::uint32_t getNumServices(void) const { return m_num_threads; }
+	
 	/**
 	 * returns an async I/O service used to schedule work (provides direct
 	 * access to avoid locking when possible)
@@ -317,7 +336,14 @@ public:
 	 */
 	virtual boost::asio::io_service& getIOService(boost::uint32_t n) {
 		PION_ASSERT(n < m_num_threads);
-		PION_ASSERT(n < m_service_pool.size());
+		if (n >= m_service_pool.size()) {
+			// the services have not been created yet
+			boost::mutex::scoped_lock scheduler_lock(m_mutex);
+			while (m_service_pool.size() < m_num_threads) {
+				boost::shared_ptr<ServicePair>	service_ptr(new ServicePair());
+				m_service_pool.push_back(service_ptr);
+			}
+		}
 		return m_service_pool[n]->first;
 	}
 
@@ -356,6 +382,118 @@ protected:
 	boost::uint32_t					m_next_service;
 };
 	
+
+///
+/// PionWorkStealingScheduler: uses a single IO service for each thread, like
+/// PionOneToOneScheduler, but gives each thread its own deque of the work it
+/// posts itself.  a thread takes its own work newest first and, once that runs
+/// out, the oldest work posted from outside of the threads, and then steals the
+/// oldest work of the other threads, so that work posted behind a slow work item
+/// doesn't have to wait for it while other threads are idle.  work posted from
+/// outside is shared by all threads and run in the order it was posted, so that
+/// it can't be starved by newer work
+/// 
+class PION_COMMON_API PionWorkStealingScheduler :
+	public PionOneToOneScheduler
+{
+public:
+	
+	/// constructs a new PionWorkStealingScheduler
+	PionWorkStealingScheduler(void)
+		: m_workers(), m_next_worker(0)
+	{}
+	
+	/// virtual destructor
+	virtual ~PionWorkStealingScheduler() { shutdown(); }
+	
+	/// Starts the thread scheduler (this is called automatically when necessary)
+	virtual void startup(void);
+	
+	/**
+	 * schedules work to be performed by one of the pooled threads.  work posted
+	 * by one of the scheduler's own threads goes to that thread's deque, other
+	 * work is queued for whichever thread gets to it first
+	 *
+	 * @param work_func work function to be executed
+	 */
+	virtual void post(boost::function0<void> work_func);
+	
+	
+protected:
+	
+	/// finishes all services used to schedule work
+	virtual void finishServices(void) {
+		m_workers.clear();
+		m_injected.clear();
+		PionOneToOneScheduler::finishServices();
+	}
+	
+	/**
+	 * thread function that runs posted work and handles the events of an IO service
+	 *
+	 * @param n integer number representing the thread and its service object
+	 */
+	void processWork(boost::uint32_t n);
+	
+	/**
+	 * takes the next work item for a thread: its own newest work, else the oldest
+	 * work posted from outside, else the oldest work stolen from another thread
+	 *
+	 * @param n integer number representing the thread
+	 * @param work_func assigned the work function to be executed
+	 *
+	 * @return true if there was work left to take
+	 */
+	bool takeWork(boost::uint32_t n, boost::function0<void>& work_func);
+	
+	/**
+	 * wakes an idle thread, preferring thread n, so that it takes posted work
+	 *
+	 * @param n integer number representing the thread to try first
+	 */
+	void wakeWorker(boost::uint32_t n);
+	
+	/// handler posted to the IO service of an idle thread to wake it up
+	static void wakeUp(void) {}
+	
+	
+	/// data type for the work posted to a single thread
+	struct Worker :
+		private boost::noncopyable
+	{
+		/// constructs a new Worker
+		Worker(void) : m_work(), m_idle(false) {}
+		
+		/// work posted to the thread, the thread takes it from the back and others steal from the front
+		std::deque<boost::function0<void> >	m_work;
+		
+		/// true while the thread waits for IO events because there is no work to take
+		bool								m_idle;
+		
+		/// mutex protecting the work and the idle flag
+		boost::mutex						m_mutex;
+	};
+	
+	/// typedef for the work of all threads
+	typedef std::vector<boost::shared_ptr<Worker> >			WorkerPool;
+	
+	
+	/// posted work of each thread, in the order of the service pool
+	WorkerPool						m_workers;
+	
+	/// work posted from outside of the threads, taken from the front
+	std::deque<boost::function0<void> >	m_injected;
+	
+	/// mutex protecting the work posted from outside of the threads
+	boost::mutex					m_injected_mutex;
+	
+	/// counts work posted from outside of the threads, to wake them round robin
+	boost::detail::atomic_count		m_next_worker;
+	
+	/// number of the scheduler's thread that is running, unset for other threads
+	boost::thread_specific_ptr<boost::uint32_t>	m_worker_index;
+};
+	
 	
 }	// end namespace pion
 
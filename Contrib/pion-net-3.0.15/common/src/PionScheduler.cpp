@@ -182,4 +182,164 @@ void PionOneToOneScheduler::startup(void)
 }
 
 	
+
+// PionWorkStealingScheduler member functions
+
+void PionWorkStealingScheduler::startup(void)
+{
+	// lock mutex for thread safety
+	boost::mutex::scoped_lock scheduler_lock(m_mutex);
+	
+	if (! m_is_running) {
+		PION_LOG_INFO(m_logger, "Starting thread scheduler");
+		
+		// make sure there are enough services and workers initialized
+		while (m_service_pool.size() < m_num_threads) {
+			boost::shared_ptr<ServicePair>	service_ptr(new ServicePair());
+			m_service_pool.push_back(service_ptr);
+		}
+		while (m_workers.size() < m_num_threads) {
+			boost::shared_ptr<Worker>	worker_ptr(new Worker());
+			m_workers.push_back(worker_ptr);
+		}
+		
+		// post() checks whether the scheduler is running under the injected work's
+		// mutex, so the workers are all there by the time it sees that it is
+		{
+			boost::mutex::scoped_lock injected_lock(m_injected_mutex);
+			m_is_running = true;
+		}
+		// schedule a work item for each service to make sure that it doesn't complete
+		for (ServicePool::iterator i = m_service_pool.begin(); i != m_service_pool.end(); ++i) {
+			keepRunning((*i)->first, (*i)->second);
+		}
+		
+		// start multiple threads to handle async tasks
+		for (boost::uint32_t n = 0; n < m_num_threads; ++n) {
+			boost::shared_ptr<boost::thread> new_thread(new boost::thread( boost::bind(&PionWorkStealingScheduler::processWork,
+																					   this, n) ));
+			m_thread_pool.push_back(new_thread);
+		}
+	}
+}
+
+void PionWorkStealingScheduler::post(boost::function0<void> work_func)
+{
+	// keep work posted by one of the threads on its own deque, where it is
+	// still hot in the cache and other threads only get to it when idle.
+	// the threads only exist while the scheduler is running
+	const boost::uint32_t *index = m_worker_index.get();
+	if (index) {
+		{
+			boost::mutex::scoped_lock worker_lock(m_workers[*index]->m_mutex);
+			m_workers[*index]->m_work.push_back(work_func);
+		}
+		wakeWorker(*index);
+		return;
+	}
+	
+	// other work is run first come, first served by whichever thread is free
+	bool queued = false;
+	{
+		boost::mutex::scoped_lock injected_lock(m_injected_mutex);
+		if (m_is_running) {
+			m_injected.push_back(work_func);
+			queued = true;
+		}
+	}
+	if (! queued) {
+		// the IO services keep the work until the threads are started
+		PionOneToOneScheduler::post(work_func);
+		return;
+	}
+	wakeWorker(static_cast<boost::uint32_t>(++m_next_worker) % m_workers.size());
+}
+
+void PionWorkStealingScheduler::processWork(boost::uint32_t n)
+{
+	m_worker_index.reset(new boost::uint32_t(n));
+	Worker& worker = *m_workers[n];
+	boost::asio::io_service& service = m_service_pool[n]->first;
+	
+	while (m_is_running) {
+		try {
+			boost::function0<void> work_func;
+			if (! takeWork(n, work_func)) {
+				{
+					boost::mutex::scoped_lock worker_lock(worker.m_mutex);
+					worker.m_idle = true;
+				}
+				// work posted before the thread became idle didn't wake it up
+				if (! takeWork(n, work_func)) {
+					// sleeps until an IO event arrives or work is posted, then
+					// handles whatever else is ready before looking for work again
+					if (service.run_one())
+						service.poll();
+				}
+				boost::mutex::scoped_lock worker_lock(worker.m_mutex);
+				worker.m_idle = false;
+			}
+			if (work_func) {
+				work_func();
+				// handle the IO events that are ready so that posted work can't starve them
+				service.poll();
+			}
+		} catch (std::exception& e) {
+			PION_LOG_ERROR(m_logger, e.what());
+		} catch (...) {
+			PION_LOG_ERROR(m_logger, "caught unrecognized exception");
+		}
+	}
+}
+
+bool PionWorkStealingScheduler::takeWork(boost::uint32_t n, boost::function0<void>& work_func)
+{
+	// take the newest work of the thread itself
+	{
+		Worker& worker = *m_workers[n];
+		boost::mutex::scoped_lock worker_lock(worker.m_mutex);
+		if (! worker.m_work.empty()) {
+			work_func.swap(worker.m_work.back());
+			worker.m_work.pop_back();
+			return true;
+		}
+	}
+	// take the oldest work posted from outside
+	{
+		boost::mutex::scoped_lock injected_lock(m_injected_mutex);
+		if (! m_injected.empty()) {
+			work_func.swap(m_injected.front());
+			m_injected.pop_front();
+			return true;
+		}
+	}
+	// steal the oldest work of the other threads
+	for (boost::uint32_t i = 1; i < m_workers.size(); ++i) {
+		Worker& victim = *m_workers[(n + i) % m_workers.size()];
+		boost::mutex::scoped_lock victim_lock(victim.m_mutex);
+		if (! victim.m_work.empty()) {
+			work_func.swap(victim.m_work.front());
+			victim.m_work.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void PionWorkStealingScheduler::wakeWorker(boost::uint32_t n)
+{
+	// an idle thread checks all queues after it is flagged idle, so either it
+	// sees the work or the work's poster sees the flag
+	for (boost::uint32_t i = 0; i < m_workers.size(); ++i) {
+		const boost::uint32_t k = (n + i) % m_workers.size();
+		boost::mutex::scoped_lock worker_lock(m_workers[k]->m_mutex);
+		if (m_workers[k]->m_idle) {
+			// clear the flag so that more work wakes up another thread
+			m_workers[k]->m_idle = false;
+			m_service_pool[k]->first.post(&PionWorkStealingScheduler::wakeUp);
+			return;
+		}
+	}
+}
+	
 }	// end namespace pion
@@ -362,11 +362,13 @@ public:
 	{
 		// update message headers
 		prepareHeadersForSend(keep_alive, using_chunks);
-		// add first message line
-		write_buffers.push_back(boost::asio::buffer(getFirstLine()));
-		write_buffers.push_back(boost::asio::buffer(STRING_CRLF));
-		// append HTTP headers
-		appendHeaders(write_buffers);
+		// the first line and headers go into a single buffer: asio only writes a
+		// limited number of buffers at once, and a message that is split over
+		// several small writes stalls on Nagle's algorithm with keep-alive
+		m_header_text = getFirstLine();
+		m_header_text += STRING_CRLF;
+		appendHeaders(m_header_text);
+		write_buffers.push_back(boost::asio::buffer(m_header_text));
 	}
 
 
@@ -413,21 +415,14 @@ protected:
 	}
 
 	/**
-	 * appends the message's HTTP headers to a vector of write buffers
+	 * appends the message's HTTP headers to the text that is sent.  this is
+	 * not inline so that code compiled against this header, which has a
+	 * different HTTPMessage layout than pion-net 3.0.15, fails to link with
+	 * an unpatched library instead of corrupting its heap
 	 *
-	 * @param write_buffers the buffers to append HTTP headers into
+	 * @param header_text the string to append HTTP headers to
 	 */
-	inline void appendHeaders(WriteBuffers& write_buffers) {
-		// add HTTP headers
-		for (Headers::const_iterator i = m_headers.begin(); i != m_headers.end(); ++i) {
-			write_buffers.push_back(boost::asio::buffer(i->first));
-			write_buffers.push_back(boost::asio::buffer(HEADER_NAME_VALUE_DELIMITER));
-			write_buffers.push_back(boost::asio::buffer(i->second));
-			write_buffers.push_back(boost::asio::buffer(STRING_CRLF));
-		}
-		// add an extra CRLF to end HTTP headers
-		write_buffers.push_back(boost::asio::buffer(STRING_CRLF));
-	}
+	void appendHeaders(std::string& header_text) const;
 
 	/**
 	 * Returns the first value in a dictionary if key is found; or an empty
@@ -549,6 +544,9 @@ private:
 	/// HTTP message headers
 	Headers							m_headers;
 
+	/// the first line and headers being sent, kept until the write is finished
+	std::string						m_header_text;
+
 	/// HTTP cookie parameters parsed from the headers
 	CookieParams					m_cookie_params;
 
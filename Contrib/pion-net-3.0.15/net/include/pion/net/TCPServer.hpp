@@ -11,6 +11,7 @@
 #define __PION_TCPSERVER_HEADER__
 
 #include <set>
+#include <vector>
 #include <boost/asio.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
@@ -83,6 +84,18 @@ public:
 	/// sets value of SSL flag (true if the server uses SSL to encrypt connections)
 	inline void setSSLFlag(bool b = true) { m_ssl_flag = b; }
 	
+	/// returns true if each of the scheduler's I/O services accepts its own connections
+	inline bool getShardedFlag(void) const { return m_sharded_flag; }
+	
+	/**
+	 * sets value of sharded flag.  if true, the server listens with one acceptor
+	 * for each of the scheduler's I/O services, all bound to the same port using
+	 * SO_REUSEPORT so that the kernel spreads new connections over them, and each
+	 * connection is handled by the service that accepted it for as long as it
+	 * lives.  takes effect the next time the server is started
+	 */
+	inline void setShardedFlag(bool b = true) { m_sharded_flag = b; }
+	
 	/// returns the SSL context for configuration
 	inline TCPConnection::SSLContext& getSSLContext(void) { return m_ssl_context; }
 	
@@ -155,42 +168,103 @@ protected:
 	
 private:
 		
+	/// data type for a pool of TCP connections
+	typedef std::set<TCPConnectionPtr>		ConnectionPool;
+	
+	///
+	/// Shard: an acceptor together with the connections that it accepted.  the
+	/// shards of a server share no state, so that they can accept and handle
+	/// connections on separate threads without contending for locks.  handlers
+	/// keep a pointer to their shard, since it outlives the server's shard pool
+	/// until its last pending operation has finished
+	///
+	struct Shard :
+		private boost::noncopyable
+	{
+		/**
+		 * constructs a new Shard
+		 *
+		 * @param service the I/O service used by the acceptor
+		 * @param pinned if true, connections are handled by the acceptor's service
+		 *               rather than spread over all of the scheduler's services
+		 */
+		Shard(boost::asio::io_service& service, bool pinned)
+			: m_service(service), m_tcp_acceptor(service), m_pinned(pinned),
+			m_is_listening(false)
+		{}
+		
+		/// I/O service used by the acceptor
+		boost::asio::io_service &			m_service;
+		
+		/// manages async TCP connections
+		boost::asio::ip::tcp::acceptor		m_tcp_acceptor;
+		
+		/// true if connections are handled by the acceptor's service
+		const bool							m_pinned;
+		
+		/// pool of active connections accepted by this shard
+		ConnectionPool						m_conn_pool;
+		
+		/// copy of the server's listening flag, so that handlers need not lock the server
+		bool								m_is_listening;
+		
+		/// mutex protecting the acceptor, the connection pool and the listening flag
+		boost::mutex						m_mutex;
+	};
+	
+	/// data type for a pointer to a shard
+	typedef boost::shared_ptr<Shard>		ShardPtr;
+	
+	/// data type for the shards of a server
+	typedef std::vector<ShardPtr>			ShardPool;
+	
+	
 	/// handles a request to stop the server
 	void handleStopRequest(void);
 	
-	/// listens for a new connection
-	void listen(void);
+	/**
+	 * binds a shard's acceptor to the server's endpoint and starts listening
+	 *
+	 * @param shard the shard whose acceptor is opened
+	 */
+	void openAcceptor(Shard& shard);
+	
+	/**
+	 * listens for a new connection
+	 *
+	 * @param shard the shard accepting the connection
+	 */
+	void listen(const ShardPtr& shard);
 
 	/**
 	 * handles new connections (checks if there was an accept error)
 	 *
+	 * @param shard the shard that accepted the connection
 	 * @param tcp_conn the new TCP connection (if no error occurred)
 	 * @param accept_error true if an error occurred while accepting connections
 	 */
-	void handleAccept(TCPConnectionPtr& tcp_conn,
+	void handleAccept(const ShardPtr& shard, TCPConnectionPtr& tcp_conn,
 					  const boost::system::error_code& accept_error);
 
 	/**
 	 * handles new connections following an SSL handshake (checks for errors)
 	 *
+	 * @param shard the shard that accepted the connection
 	 * @param tcp_conn the new TCP connection (if no error occurred)
 	 * @param handshake_error true if an error occurred during the SSL handshake
 	 */
-	void handleSSLHandshake(TCPConnectionPtr& tcp_conn,
+	void handleSSLHandshake(const ShardPtr& shard, TCPConnectionPtr& tcp_conn,
 							const boost::system::error_code& handshake_error);
 	
 	/// This will be called by TCPConnection::finish() after a server has
 	/// finished handling a connection.  If the keep_alive flag is true,
 	/// it will call handleConnection(); otherwise, it will close the
-	/// connection and remove it from the server's management pool
-	void finishConnection(TCPConnectionPtr& tcp_conn);
+	/// connection and remove it from the shard's management pool
+	void finishConnection(const ShardPtr& shard, TCPConnectionPtr& tcp_conn);
 	
-    /// prunes orphaned connections that did not close cleanly
-    /// and returns the remaining number of connections in the pool
-    std::size_t pruneConnections(void);
-	
-	/// data type for a pool of TCP connections
-	typedef std::set<TCPConnectionPtr>		ConnectionPool;
+    /// prunes orphaned connections of a shard that did not close cleanly
+    /// and returns the remaining number of connections in its pool
+    std::size_t pruneConnections(Shard& shard);
 	
 	
 	/// the default PionScheduler object used to manage worker threads
@@ -199,8 +273,8 @@ private:
 	/// reference to the active PionScheduler object used to manage worker threads
 	PionScheduler &							m_active_scheduler;
 	
-	/// manages async TCP connections
-	boost::asio::ip::tcp::acceptor			m_tcp_acceptor;
+	/// acceptors and connections of the server, one for each I/O service if sharded
+	ShardPool								m_shards;
 
 	/// context used for SSL configuration
 	TCPConnection::SSLContext				m_ssl_context;
@@ -211,15 +285,15 @@ private:
 	/// condition triggered when the connection pool is empty
 	boost::condition						m_no_more_connections;
 
-	/// pool of active connections associated with this server 
-	ConnectionPool							m_conn_pool;
-
 	/// tcp endpoint used to listen for new connections
 	boost::asio::ip::tcp::endpoint			m_endpoint;
 
 	/// true if the server uses SSL to encrypt connections
 	bool									m_ssl_flag;
 
+	/// true if each of the scheduler's I/O services accepts its own connections
+	bool									m_sharded_flag;
+
 	/// set to true when the server is listening for new connections
 	bool									m_is_listening;
 
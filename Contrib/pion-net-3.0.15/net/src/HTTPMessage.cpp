@@ -132,6 +132,19 @@ std::size_t HTTPMessage::receive(TCPConnection& tcp_conn,
 	return (http_parser.getTotalBytesRead());
 }
 	
+void HTTPMessage::appendHeaders(std::string& header_text) const
+{
+	// add HTTP headers
+	for (Headers::const_iterator i = m_headers.begin(); i != m_headers.end(); ++i) {
+		header_text += i->first;
+		header_text += HEADER_NAME_VALUE_DELIMITER;
+		header_text += i->second;
+		header_text += STRING_CRLF;
+	}
+	// add an extra CRLF to end HTTP headers
+	header_text += STRING_CRLF;
+}
+
 void HTTPMessage::concatenateChunks(void)
 {
 	setContentLength(m_chunk_cache.size());
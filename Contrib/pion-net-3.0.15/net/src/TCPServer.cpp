@@ -15,6 +15,13 @@
 
 using boost::asio::ip::tcp;
 
+#ifdef SO_REUSEPORT
+namespace {
+	/// lets several sockets bind to the same address, the kernel spreads connections over them
+	typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>	reuse_port;
+}
+#endif
+
 
 namespace pion {	// begin namespace pion
 namespace net {		// begin namespace net (Pion Network Library)
@@ -25,49 +32,45 @@ namespace net {		// begin namespace net (Pion Network Library)
 TCPServer::TCPServer(PionScheduler& scheduler, const unsigned int tcp_port)
 	: m_logger(PION_GET_LOGGER("pion.net.TCPServer")),
 	m_active_scheduler(scheduler),
-	m_tcp_acceptor(m_active_scheduler.getIOService()),
 #ifdef PION_HAVE_SSL
 	m_ssl_context(m_active_scheduler.getIOService(), boost::asio::ssl::context::sslv23),
 #else
 	m_ssl_context(0),
 #endif
-	m_endpoint(tcp::v4(), tcp_port), m_ssl_flag(false), m_is_listening(false)
+	m_endpoint(tcp::v4(), tcp_port), m_ssl_flag(false), m_sharded_flag(false), m_is_listening(false)
 {}
 	
 TCPServer::TCPServer(PionScheduler& scheduler, const tcp::endpoint& endpoint)
 	: m_logger(PION_GET_LOGGER("pion.net.TCPServer")),
 	m_active_scheduler(scheduler),
-	m_tcp_acceptor(m_active_scheduler.getIOService()),
 #ifdef PION_HAVE_SSL
 	m_ssl_context(m_active_scheduler.getIOService(), boost::asio::ssl::context::sslv23),
 #else
 	m_ssl_context(0),
 #endif
-	m_endpoint(endpoint), m_ssl_flag(false), m_is_listening(false)
+	m_endpoint(endpoint), m_ssl_flag(false), m_sharded_flag(false), m_is_listening(false)
 {}
 
 TCPServer::TCPServer(const unsigned int tcp_port)
 	: m_logger(PION_GET_LOGGER("pion.net.TCPServer")),
 	m_default_scheduler(), m_active_scheduler(m_default_scheduler),
-	m_tcp_acceptor(m_active_scheduler.getIOService()),
 #ifdef PION_HAVE_SSL
 	m_ssl_context(m_active_scheduler.getIOService(), boost::asio::ssl::context::sslv23),
 #else
 	m_ssl_context(0),
 #endif
-	m_endpoint(tcp::v4(), tcp_port), m_ssl_flag(false), m_is_listening(false)
+	m_endpoint(tcp::v4(), tcp_port), m_ssl_flag(false), m_sharded_flag(false), m_is_listening(false)
 {}
 
 TCPServer::TCPServer(const tcp::endpoint& endpoint)
 	: m_logger(PION_GET_LOGGER("pion.net.TCPServer")),
 	m_default_scheduler(), m_active_scheduler(m_default_scheduler),
-	m_tcp_acceptor(m_active_scheduler.getIOService()),
 #ifdef PION_HAVE_SSL
 	m_ssl_context(m_active_scheduler.getIOService(), boost::asio::ssl::context::sslv23),
 #else
 	m_ssl_context(0),
 #endif
-	m_endpoint(endpoint), m_ssl_flag(false), m_is_listening(false)
+	m_endpoint(endpoint), m_ssl_flag(false), m_sharded_flag(false), m_is_listening(false)
 {}
 	
 void TCPServer::start(void)
@@ -80,24 +83,34 @@ void TCPServer::start(void)
 		
 		beforeStarting();
 
-		// configure the acceptor service
+		// without sharding, a single acceptor hands connections to any of the services
+		bool sharded = false;
+		boost::uint32_t num_shards = 1;
+		if (m_sharded_flag) {
+#ifdef SO_REUSEPORT
+			sharded = true;
+			num_shards = m_active_scheduler.getNumServices();
+#else
+			PION_LOG_WARN(m_logger, "SO_REUSEPORT is not supported, using a single acceptor");
+#endif
+		}
+
+		// configure the acceptor services
+		m_shards.clear();
 		try {
 			// get admin permissions in case we're binding to a privileged port
 			pion::PionAdminRights use_admin_rights(getPort() < 1024);
-			m_tcp_acceptor.open(m_endpoint.protocol());
-			// allow the acceptor to reuse the address (i.e. SO_REUSEADDR)
-			// ...except when running not on Windows - see http://msdn.microsoft.com/en-us/library/ms740621%28VS.85%29.aspx
-#ifndef _MSC_VER
-			m_tcp_acceptor.set_option(tcp::acceptor::reuse_address(true));
-#endif
-			m_tcp_acceptor.bind(m_endpoint);
-			if (m_endpoint.port() == 0) {
-				// update the endpoint to reflect the port chosen by bind
-				m_endpoint = m_tcp_acceptor.local_endpoint();
+			for (boost::uint32_t n = 0; n < num_shards; ++n) {
+				ShardPtr shard(sharded
+							   ? new Shard(m_active_scheduler.getIOService(n), true)
+							   : new Shard(m_active_scheduler.getIOService(), false));
+				m_shards.push_back(shard);
+				openAcceptor(*shard);
+				shard->m_is_listening = true;
 			}
-			m_tcp_acceptor.listen();
 		} catch (std::exception& e) {
 			PION_LOG_ERROR(m_logger, "Unable to bind to port " << getPort() << ": " << e.what());
+			m_shards.clear();
 			throw;
 		}
 
@@ -105,7 +118,8 @@ void TCPServer::start(void)
 
 		// unlock the mutex since listen() requires its own lock
 		server_lock.unlock();
-		listen();
+		for (ShardPool::iterator i = m_shards.begin(); i != m_shards.end(); ++i)
+			listen(*i);
 		
 		// notify the thread scheduler that we need it now
 		m_active_scheduler.addActiveUser();
@@ -122,19 +136,29 @@ void TCPServer::stop(bool wait_until_finished)
 	
 		m_is_listening = false;
 
-		// this terminates any connections waiting to be accepted
-		m_tcp_acceptor.close();
-		
-		if (! wait_until_finished) {
-			// this terminates any other open connections
-			std::for_each(m_conn_pool.begin(), m_conn_pool.end(),
-						  boost::bind(&TCPConnection::close, _1));
+		for (ShardPool::iterator i = m_shards.begin(); i != m_shards.end(); ++i) {
+			boost::mutex::scoped_lock shard_lock((*i)->m_mutex);
+			(*i)->m_is_listening = false;
+			
+			// this terminates any connections waiting to be accepted
+			(*i)->m_tcp_acceptor.close();
+			
+			if (! wait_until_finished) {
+				// this terminates any other open connections
+				std::for_each((*i)->m_conn_pool.begin(), (*i)->m_conn_pool.end(),
+							  boost::bind(&TCPConnection::close, _1));
+			}
 		}
 	
 		// wait for all pending connections to complete
-		while (! m_conn_pool.empty()) {
-			// try to prun connections that didn't finish cleanly
-			if (pruneConnections() == 0)
+		while (true) {
+			// try to prune connections that didn't finish cleanly
+			std::size_t remaining = 0;
+			for (ShardPool::iterator i = m_shards.begin(); i != m_shards.end(); ++i) {
+				boost::mutex::scoped_lock shard_lock((*i)->m_mutex);
+				remaining += pruneConnections(**i);
+			}
+			if (remaining == 0)
 				break;	// if no more left, then we can stop waiting
 			// sleep for up to a quarter second to give open connections a chance to finish
 			PION_LOG_INFO(m_logger, "Waiting for open connections to finish");
@@ -172,57 +196,84 @@ void TCPServer::setSSLKeyFile(const std::string& pem_key_file)
 #endif
 }
 
-void TCPServer::listen(void)
+void TCPServer::openAcceptor(Shard& shard)
+{
+	shard.m_tcp_acceptor.open(m_endpoint.protocol());
+	// allow the acceptor to reuse the address (i.e. SO_REUSEADDR)
+	// ...except when running not on Windows - see http://msdn.microsoft.com/en-us/library/ms740621%28VS.85%29.aspx
+#ifndef _MSC_VER
+	shard.m_tcp_acceptor.set_option(tcp::acceptor::reuse_address(true));
+#endif
+#ifdef SO_REUSEPORT
+	// every shard binds to the same port, each pinned to the service it accepts on
+	if (shard.m_pinned)
+		shard.m_tcp_acceptor.set_option(reuse_port(true));
+#endif
+	shard.m_tcp_acceptor.bind(m_endpoint);
+	if (m_endpoint.port() == 0) {
+		// update the endpoint to reflect the port chosen by bind
+		m_endpoint = shard.m_tcp_acceptor.local_endpoint();
+	}
+	shard.m_tcp_acceptor.listen();
+}
+
+void TCPServer::listen(const ShardPtr& shard)
 {
 	// lock mutex for thread safety
-	boost::mutex::scoped_lock server_lock(m_mutex);
+	boost::mutex::scoped_lock shard_lock(shard->m_mutex);
 	
-	if (m_is_listening) {
+	if (shard->m_is_listening) {
 		// create a new TCP connection object
-		TCPConnectionPtr new_connection(TCPConnection::create(getIOService(),
+		TCPConnectionPtr new_connection(TCPConnection::create(shard->m_pinned ? shard->m_service : getIOService(),
 															  m_ssl_context, m_ssl_flag,
 															  boost::bind(&TCPServer::finishConnection,
-																		  this, _1)));
+																		  this, shard, _1)));
 		
 		// prune connections that finished uncleanly
-		pruneConnections();
+		pruneConnections(*shard);
 
-		// keep track of the object in the server's connection pool
-		m_conn_pool.insert(new_connection);
+		// keep track of the object in the shard's connection pool
+		shard->m_conn_pool.insert(new_connection);
 		
 		// use the object to accept a new connection
-		new_connection->async_accept(m_tcp_acceptor,
+		new_connection->async_accept(shard->m_tcp_acceptor,
 									 boost::bind(&TCPServer::handleAccept,
-												 this, new_connection,
+												 this, shard, new_connection,
 												 boost::asio::placeholders::error));
 	}
 }
 
-void TCPServer::handleAccept(TCPConnectionPtr& tcp_conn,
+void TCPServer::handleAccept(const ShardPtr& shard, TCPConnectionPtr& tcp_conn,
 							 const boost::system::error_code& accept_error)
 {
 	if (accept_error) {
 		// an error occured while trying to a accept a new connection
 		// this happens when the server is being shut down
-		if (m_is_listening) {
-			listen();	// schedule acceptance of another connection
+		bool is_listening;
+		{
+			boost::mutex::scoped_lock shard_lock(shard->m_mutex);
+			is_listening = shard->m_is_listening;
+		}
+		if (is_listening) {
+			listen(shard);	// schedule acceptance of another connection
 			PION_LOG_WARN(m_logger, "Accept error on port " << getPort() << ": " << accept_error.message());
 		}
-		finishConnection(tcp_conn);
+		finishConnection(shard, tcp_conn);
 	} else {
 		// got a new TCP connection
 		PION_LOG_DEBUG(m_logger, "New" << (tcp_conn->getSSLFlag() ? " SSL " : " ")
 					   << "connection on port " << getPort());
 
 		// schedule the acceptance of another new connection
-		// (this returns immediately since it schedules it as an event)
-		if (m_is_listening) listen();
+		// (this returns immediately since it schedules it as an event,
+		// and does nothing if the server has stopped listening)
+		listen(shard);
 		
 		// handle the new connection
 #ifdef PION_HAVE_SSL
 		if (tcp_conn->getSSLFlag()) {
 			tcp_conn->async_handshake_server(boost::bind(&TCPServer::handleSSLHandshake,
-														 this, tcp_conn,
+														 this, shard, tcp_conn,
 														 boost::asio::placeholders::error));
 		} else
 #endif
@@ -231,14 +282,14 @@ void TCPServer::handleAccept(TCPConnectionPtr& tcp_conn,
 	}
 }
 
-void TCPServer::handleSSLHandshake(TCPConnectionPtr& tcp_conn,
+void TCPServer::handleSSLHandshake(const ShardPtr& shard, TCPConnectionPtr& tcp_conn,
 								   const boost::system::error_code& handshake_error)
 {
 	if (handshake_error) {
 		// an error occured while trying to establish the SSL connection
 		PION_LOG_WARN(m_logger, "SSL handshake failed on port " << getPort()
 					  << " (" << handshake_error.message() << ')');
-		finishConnection(tcp_conn);
+		finishConnection(shard, tcp_conn);
 	} else {
 		// handle the new connection
 		PION_LOG_DEBUG(m_logger, "SSL handshake succeeded on port " << getPort());
@@ -246,10 +297,10 @@ void TCPServer::handleSSLHandshake(TCPConnectionPtr& tcp_conn,
 	}
 }
 
-void TCPServer::finishConnection(TCPConnectionPtr& tcp_conn)
+void TCPServer::finishConnection(const ShardPtr& shard, TCPConnectionPtr& tcp_conn)
 {
-	boost::mutex::scoped_lock server_lock(m_mutex);
-	if (m_is_listening && tcp_conn->getKeepAlive()) {
+	boost::mutex::scoped_lock shard_lock(shard->m_mutex);
+	if (shard->m_is_listening && tcp_conn->getKeepAlive()) {
 		
 		// keep the connection alive
 		handleConnection(tcp_conn);
@@ -257,41 +308,49 @@ void TCPServer::finishConnection(TCPConnectionPtr& tcp_conn)
 	} else {
 		PION_LOG_DEBUG(m_logger, "Closing connection on port " << getPort());
 		
-		// remove the connection from the server's management pool
-		ConnectionPool::iterator conn_itr = m_conn_pool.find(tcp_conn);
-		if (conn_itr != m_conn_pool.end())
-			m_conn_pool.erase(conn_itr);
+		// remove the connection from the shard's management pool
+		ConnectionPool::iterator conn_itr = shard->m_conn_pool.find(tcp_conn);
+		if (conn_itr != shard->m_conn_pool.end())
+			shard->m_conn_pool.erase(conn_itr);
 
 		// trigger the no more connections condition if we're waiting to stop
-		if (!m_is_listening && m_conn_pool.empty())
+		if (!shard->m_is_listening && shard->m_conn_pool.empty())
 			m_no_more_connections.notify_all();
 	}
 }
 
-std::size_t TCPServer::pruneConnections(void)
+std::size_t TCPServer::pruneConnections(Shard& shard)
 {
-	// assumes that a server lock has already been acquired
-	ConnectionPool::iterator conn_itr = m_conn_pool.begin();
-	while (conn_itr != m_conn_pool.end()) {
+	// assumes that a shard lock has already been acquired
+	ConnectionPool::iterator conn_itr = shard.m_conn_pool.begin();
+	while (conn_itr != shard.m_conn_pool.end()) {
 		if (conn_itr->unique()) {
 			PION_LOG_WARN(m_logger, "Closing orphaned connection on port " << getPort());
 			ConnectionPool::iterator erase_itr = conn_itr;
 			++conn_itr;
 			(*erase_itr)->close();
-			m_conn_pool.erase(erase_itr);
+			shard.m_conn_pool.erase(erase_itr);
 		} else {
 			++conn_itr;
 		}
 	}
 
 	// return the number of connections remaining
-	return m_conn_pool.size();
+	return shard.m_conn_pool.size();
 }
 
 std::size_t TCPServer::getConnections(void) const
 {
 	boost::mutex::scoped_lock server_lock(m_mutex);
-	return (m_is_listening ? (m_conn_pool.size() - 1) : m_conn_pool.size());
+	std::size_t connections = 0;
+	for (ShardPool::const_iterator i = m_shards.begin(); i != m_shards.end(); ++i) {
+		boost::mutex::scoped_lock shard_lock((*i)->m_mutex);
+		connections += (*i)->m_conn_pool.size();
+		// each listening shard holds a connection waiting to be accepted
+		if (m_is_listening)
+			--connections;
+	}
+	return connections;
 }
 
 }	// end namespace net